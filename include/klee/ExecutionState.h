@@ -55,6 +55,8 @@ namespace klee {
 
 			std::map<std::string, std::string> fnAliases;
 
+			bool canProgress(Thread* thread, std::set<unsigned>& progress);
+
 		public:
 			// Execution - Control Flow specific
 
@@ -157,6 +159,10 @@ namespace klee {
 
 			bool examineAllThreadFinalState();
 
+			bool findDeadlock(std::vector<Thread*>& deadlocked);
+
+			void printDeadlock(std::vector<Thread*>& deadlocked, std::ostream &out);
+
 			unsigned getNextThreadId();
 
 			Thread* createThread(KFunction *kf);
@@ -15,8 +15,49 @@
 namespace klee {
   class MemoryObject;
 
+  /// A register. Concrete values of at most 64 bits are also kept inline,
+  /// so that the interpreter can compute on them without building
+  /// ConstantExprs. The Expr of such a value is only built by getValue().
   struct Cell {
-    ref<Expr> value;
+  private:
+    mutable ref<Expr> value;
+    uint64_t constant;
+    /// Width of constant, 0 if the cell does not hold a small constant.
+    Expr::Width width;
+
+  public:
+    Cell() : constant(0), width(0) {}
+
+    ref<Expr> getValue() const {
+      if (width && value.isNull())
+        value = ConstantExpr::create(constant, width);
+      return value;
+    }
+
+    void setValue(const ref<Expr> &e) {
+      value = e;
+      width = 0;
+      if (!e.isNull()) {
+        if (ConstantExpr *ce = dyn_cast<ConstantExpr>(e)) {
+          if (ce->getWidth() <= Expr::Int64) {
+            constant = ce->getZExtValue();
+            width = ce->getWidth();
+          }
+        }
+      }
+    }
+
+    /// Set the cell to a concrete value of width w, at most 64 bits.
+    void setConstant(uint64_t c, Expr::Width w) {
+      if (!value.isNull())
+        value = ref<Expr>();
+      constant = w < Expr::Int64 ? c & ((1ULL << w) - 1) : c;
+      width = w;
+    }
+
+    bool isConstant() const { return width != 0; }
+    uint64_t getConstant() const { return constant; }
+    Expr::Width getWidth() const { return width; }
   };
 }
 
@@ -22,6 +22,19 @@ namespace klee {
   class Executor;
   struct InstructionInfo;
   class KModule;
+  class MemoryObject;
+  class ObjectState;
+
+  /// ResolutionCache - The last objects a load or store resolved to, each
+  /// with the generation of the address space it was found in. See
+  /// AddressSpace::resolveOne.
+  struct ResolutionCache {
+    enum { Size = 4 };
+    uint64_t generation[Size];
+    const MemoryObject *mo[Size];
+    const ObjectState *os[Size];
+    unsigned next;
+  };
 
 
   /// KInstruction - Intermediate instruction representation used
@@ -37,6 +50,29 @@ namespace klee {
     int *operands;
     /// Destination register index.
     unsigned dest;
+    /// Inline cache of the address resolution, only for loads and stores.
+    ResolutionCache *resolutionCache;
+
+    /// How the instruction may touch memory shared between threads, as
+    /// computed by SharedAccessPass. ThreadLocal instructions never do.
+    enum AccessKind {
+      ThreadLocal,
+      MaybeShared,
+      Sync
+    };
+    AccessKind access;
+
+    /// Facts LocksetPass found about a load or store of a global variable
+    /// that is always accessed under a common mutex.
+    enum LockFact {
+      /// The load reads the store of the same address earlier in its own
+      /// critical section, no other thread can write in between.
+      ReadsOwnWrite = 1,
+      /// The next visible operation of the thread is another access in the
+      /// same critical section, no thread switch is needed after this one.
+      NoSwitchAfter = 2
+    };
+    unsigned lockFacts;
 
   public:
     virtual ~KInstruction(); 
@@ -14,19 +14,27 @@
 
 #include "klee/Expr.h"
 #include "klee/TimerStatIncrementer.h"
+#include "klee/Internal/Module/KInstruction.h"
 
 using namespace klee;
 
+uint64_t AddressSpace::lastGeneration = 0;
+
 ///
 
 void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
   assert(os->copyOnWriteOwner==0 && "object already has owner");
   os->copyOnWriteOwner = cowKey;
+  // a new object can not make a cached resolution stale, a new state of a
+  // bound one can
+  if (objects.lookup(mo))
+    touch();
   objects = objects.replace(std::make_pair(mo, os));
 }
 
 void AddressSpace::unbindObject(const MemoryObject *mo) {
   objects = objects.remove(mo);
+  touch();
 }
 
 const ObjectState *AddressSpace::findObject(const MemoryObject *mo) const {
@@ -45,6 +53,7 @@ ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
     ObjectState *n = new ObjectState(*os);
     n->copyOnWriteOwner = cowKey;
     objects = objects.replace(std::make_pair(mo, n));
+    touch();
     return n;    
   }
 }
@@ -52,8 +61,21 @@ ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
 /// 
 
 bool AddressSpace::resolveOne(const ref<ConstantExpr> &addr, 
-                              ObjectPair &result) {
+                              ObjectPair &result,
+                              ResolutionCache *cache) {
   uint64_t address = addr->getZExtValue();
+  if (cache) {
+    for (unsigned i = 0; i < ResolutionCache::Size; i++) {
+      if (cache->generation[i] != generation)
+        continue;
+      const MemoryObject *mo = cache->mo[i];
+      if ((mo->size==0 && address==mo->address) ||
+          (address - mo->address < mo->size)) {
+        result = ObjectPair(mo, cache->os[i]);
+        return true;
+      }
+    }
+  }
   MemoryObject hack(address);
 //  std::cerr << "objects.dump()" << "\n";
 //  objects.dump();
@@ -66,6 +88,13 @@ bool AddressSpace::resolveOne(const ref<ConstantExpr> &addr,
         (address - mo->address < mo->size)) {
 //    	std::cerr << "(mo->size==0 && address==mo->address) || (address - mo->address < mo->size)\n";
       result = *res;
+      if (cache) {
+        unsigned i = cache->next;
+        cache->next = (i + 1) % ResolutionCache::Size;
+        cache->generation[i] = generation;
+        cache->mo[i] = result.first;
+        cache->os[i] = result.second;
+      }
       return true;
     }
   }
@@ -77,9 +106,10 @@ bool AddressSpace::resolveOne(ExecutionState &state,
                               TimingSolver *solver,
                               ref<Expr> address,
                               ObjectPair &result,
-                              bool &success) {
+                              bool &success,
+                              ResolutionCache *cache) {
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(address)) {
-    success = resolveOne(CE, result);
+    success = resolveOne(CE, result, cache);
     return true;
   } else {
     TimerStatIncrementer timer(stats::resolveTime);
@@ -20,6 +20,7 @@ namespace klee {
   class MemoryObject;
   class ObjectState;
   class TimingSolver;
+  struct ResolutionCache;
 
   template<class T> class ref;
 
@@ -38,6 +39,16 @@ namespace klee {
     /// Epoch counter used to control ownership of objects.
     mutable unsigned cowKey;
 
+    /// Changes whenever an object is unbound, copied or bound to a new
+    /// state and is never shared by two address spaces, so the ObjectPairs
+    /// cached under it by resolveOne stay valid as long as it does not
+    /// change. Binding a new object leaves it alone: it can not overlap the
+    /// objects already cached.
+    uint64_t generation;
+    static uint64_t lastGeneration;
+
+    void touch() { generation = ++lastGeneration; }
+
     /// Unsupported, use copy constructor
     AddressSpace &operator=(const AddressSpace&); 
     
@@ -52,14 +63,18 @@ namespace klee {
     MemoryMap objects;
     
   public:
-    AddressSpace() : cowKey(1) {}
-    AddressSpace(const AddressSpace &b) : cowKey(++b.cowKey), objects(b.objects) { }
+    AddressSpace() : cowKey(1) { touch(); }
+    AddressSpace(const AddressSpace &b) : cowKey(++b.cowKey), objects(b.objects) { touch(); }
     ~AddressSpace() {}
 
     /// Resolve address to an ObjectPair in result.
+    ///
+    /// \param cache The inline cache of the instruction, if any. A hit
+    ///               skips the lookup in objects.
     /// \return true iff an object was found.
     bool resolveOne(const ref<ConstantExpr> &address, 
-                    ObjectPair &result);
+                    ObjectPair &result,
+                    ResolutionCache *cache = 0);
 
     /// Resolve address to an ObjectPair in result.
     ///
@@ -74,7 +89,8 @@ namespace klee {
                     TimingSolver *solver,
                     ref<Expr> address,
                     ObjectPair &result,
-                    bool &success);
+                    bool &success,
+                    ResolutionCache *cache = 0);
 
     /// Resolve address to a list of ObjectPairs it can point to. If
     /// maxResolutions is non-zero then no more than that many pairs
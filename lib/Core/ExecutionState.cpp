@@ -20,6 +20,8 @@
 #include "../../include/klee/Config/Version.h"
 #include "../../include/klee/Internal/ADT/ImmutableMap.h"
 #include "../../include/klee/Internal/ADT/ImmutableTree.h"
+#include "../../include/klee/Internal/Module/InstructionInfoTable.h"
+#include "../../include/klee/Internal/Module/KInstruction.h"
 #include "../../include/klee/Internal/Module/KModule.h"
 #include "../Thread/StackType.h"
 #include "../Thread/Thread.h"
@@ -324,13 +326,13 @@ bool ExecutionState::merge(const ExecutionState &b) {
     StackFrame &af = *itA;
     const StackFrame &bf = *itB;
     for (unsigned i=0; i<af.kf->numRegisters; i++) {
-      ref<Expr> &av = af.locals[i].value;
-      const ref<Expr> &bv = bf.locals[i].value;
+      ref<Expr> av = af.locals[i].getValue();
+      ref<Expr> bv = bf.locals[i].getValue();
       if (av.isNull() || bv.isNull()) {
         // if one is null then by implication (we are at same pc)
         // we cannot reuse this local, so just ignore
       } else {
-        av = SelectExpr::create(inA, av, bv);
+        af.locals[i].setValue(SelectExpr::create(inA, av, bv));
       }
     }
   }
@@ -414,6 +416,115 @@ bool ExecutionState::examineAllThreadFinalState() {
 	return isAllThreadFinished;
 }
 
+//the edges of the wait-for graph: a thread blocked on a mutex waits for its owner, a joining
+//thread for the joined one, a thread at a condition or a barrier for any other thread
+bool ExecutionState::canProgress(Thread* thread, std::set<unsigned>& progress) {
+	switch (thread->threadState) {
+		case Thread::RUNNABLE: {
+			return true;
+		}
+		case Thread::MUTEX_BLOCKED: {
+			Mutex* mutex = mutexManager.getBlockingMutex(thread->threadId);
+			return !mutex || !mutex->isMutexLocked() || progress.count(mutex->getLockedThread());
+		}
+		case Thread::JOIN_BLOCKED: {
+			for (std::map<unsigned, std::vector<unsigned> >::iterator ji = joinRecord.begin(), je = joinRecord.end(); ji != je; ji++) {
+				if (std::find(ji->second.begin(), ji->second.end(), thread->threadId) != ji->second.end()) {
+					return progress.count(ji->first);
+				}
+			}
+			return true;
+		}
+		case Thread::COND_BLOCKED: {
+			return !progress.empty();
+		}
+		case Thread::BARRIER_BLOCKED: {
+			std::string barrierName, otherName;
+			barrierManager.getBlockingBarrier(thread->threadId, barrierName);
+			for (std::set<unsigned>::iterator pi = progress.begin(), pe = progress.end(); pi != pe; pi++) {
+				if (!barrierManager.getBlockingBarrier(*pi, otherName) || otherName != barrierName) {
+					return true;
+				}
+			}
+			return false;
+		}
+		default: {
+			return false;
+		}
+	}
+}
+
+//the threads which never run again: every one waits, directly or through others, for a thread of the set.
+//threads that can progress are found from the runnable ones until nothing changes
+bool ExecutionState::findDeadlock(std::vector<Thread*>& deadlocked) {
+	std::set<unsigned> progress;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (ThreadList::iterator ti = threadList.begin(), te = threadList.end(); ti != te; ti++) {
+			Thread* thread = *ti;
+			if (!thread->isTerminated() && !progress.count(thread->threadId) && canProgress(thread, progress)) {
+				progress.insert(thread->threadId);
+				changed = true;
+			}
+		}
+	}
+	deadlocked.clear();
+	for (ThreadList::iterator ti = threadList.begin(), te = threadList.end(); ti != te; ti++) {
+		Thread* thread = *ti;
+		if (!thread->isTerminated() && !progress.count(thread->threadId)) {
+			deadlocked.push_back(thread);
+		}
+	}
+	return !deadlocked.empty();
+}
+
+void ExecutionState::printDeadlock(std::vector<Thread*>& deadlocked, std::ostream &out) {
+	out << "deadlock of " << deadlocked.size() << " threads" << std::endl;
+	for (std::vector<Thread*>::iterator ti = deadlocked.begin(), te = deadlocked.end(); ti != te; ti++) {
+		Thread* thread = *ti;
+		KInstruction* ki = thread->prevPC;
+		out << "thread " << thread->threadId << " at " << ki->info->file << " : " << ki->info->line << " ";
+		switch (thread->threadState) {
+			case Thread::MUTEX_BLOCKED: {
+				Mutex* mutex = mutexManager.getBlockingMutex(thread->threadId);
+				Thread* owner = findThreadById(mutex->getLockedThread());
+				out << "waits for mutex " << mutex->name << " held by thread " << owner->threadId;
+				if (owner->isTerminated()) {
+					out << " which has finished";
+				}
+				break;
+			}
+			case Thread::JOIN_BLOCKED: {
+				out << "joins thread";
+				for (std::map<unsigned, std::vector<unsigned> >::iterator ji = joinRecord.begin(), je = joinRecord.end(); ji != je; ji++) {
+					if (std::find(ji->second.begin(), ji->second.end(), thread->threadId) != ji->second.end()) {
+						out << " " << ji->first;
+					}
+				}
+				break;
+			}
+			case Thread::COND_BLOCKED: {
+				std::string condName;
+				condManager.getWaitingCondition(thread->threadId, condName);
+				out << "waits for condition " << condName;
+				break;
+			}
+			case Thread::BARRIER_BLOCKED: {
+				std::string barrierName;
+				barrierManager.getBlockingBarrier(thread->threadId, barrierName);
+				out << "waits at barrier " << barrierName;
+				break;
+			}
+			default: {
+				out << "state " << thread->threadState;
+				break;
+			}
+		}
+		out << std::endl;
+	}
+}
+
 unsigned ExecutionState::getNextThreadId() {
 	unsigned threadId = nextThreadId++;
 	assert (nextThreadId < 17 && "vector clock 只有16个");
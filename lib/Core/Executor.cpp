@@ -222,6 +222,8 @@ Executor::Executor(const InterpreterOptions &opts, InterpreterHandler *ih) :
 						std::min(MaxCoreSolverTime, MaxInstructionTime) : std::max(MaxCoreSolverTime, MaxInstructionTime)), debugInstFile(
 				0), debugLogBuffer(debugBufferString), isFinished(false), prefix(NULL), executionNum(0), execStatus(SUCCESS) {
 
+	currentAccess.ki = 0;
+
 	if (coreSolverTimeout)
 		UseForkedCoreSolver = true;
 	Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
@@ -919,20 +921,164 @@ void Executor::ineval(KInstruction *ki, unsigned index, ExecutionState &state, r
 	// Determine if this is a constant or not.
 	if (vnumber < 0) {
 		unsigned index = -vnumber - 2;
-		kmodule->constantTable[index].value = value;
+		kmodule->constantTable[index].setValue(value);
 	} else {
 		unsigned index = vnumber;
 		StackFrame &sf = state.currentStack->realStack.back();
-		sf.locals[index].value = value;
+		sf.locals[index].setValue(value);
 	}
 }
 
 void Executor::bindLocal(KInstruction *target, ExecutionState &state, ref<Expr> value) {
-	getDestCell(state, target).value = value;
+	getDestCell(state, target).setValue(value);
 }
 
 void Executor::bindArgument(KFunction *kf, unsigned index, ExecutionState &state, ref<Expr> value) {
-	getArgumentCell(state, kf, index).value = value;
+	getArgumentCell(state, kf, index).setValue(value);
+}
+
+static inline int64_t signExtendConstant(uint64_t value, Expr::Width width) {
+	if (width >= Expr::Int64)
+		return (int64_t) value;
+	unsigned shift = Expr::Int64 - width;
+	return (int64_t) (value << shift) >> shift;
+}
+
+bool Executor::bindConstantBinary(KInstruction *ki, ExecutionState &state, const Cell &left, const Cell &right) {
+	if (!left.isConstant() || !right.isConstant() || left.getWidth() != right.getWidth())
+		return false;
+	Expr::Width width = left.getWidth();
+	uint64_t l = left.getConstant(), r = right.getConstant();
+	uint64_t result;
+	switch (ki->inst->getOpcode()) {
+		case Instruction::Add:
+			result = l + r;
+			break;
+		case Instruction::Sub:
+			result = l - r;
+			break;
+		case Instruction::Mul:
+			result = l * r;
+			break;
+		case Instruction::UDiv:
+		case Instruction::URem:
+			//division by zero is left to the Expr library
+			if (r == 0)
+				return false;
+			result = ki->inst->getOpcode() == Instruction::UDiv ? l / r : l % r;
+			break;
+		case Instruction::SDiv:
+		case Instruction::SRem: {
+			int64_t sl = signExtendConstant(l, width), sr = signExtendConstant(r, width);
+			if (sr == 0 || (sr == -1 && sl == INT64_MIN))
+				return false;
+			result = ki->inst->getOpcode() == Instruction::SDiv ? sl / sr : sl % sr;
+			break;
+		}
+		case Instruction::And:
+			result = l & r;
+			break;
+		case Instruction::Or:
+			result = l | r;
+			break;
+		case Instruction::Xor:
+			result = l ^ r;
+			break;
+		case Instruction::Shl:
+		case Instruction::LShr:
+		case Instruction::AShr:
+			//so are oversized shifts
+			if (r >= width)
+				return false;
+			if (ki->inst->getOpcode() == Instruction::Shl)
+				result = l << r;
+			else if (ki->inst->getOpcode() == Instruction::LShr)
+				result = l >> r;
+			else
+				result = signExtendConstant(l, width) >> r;
+			break;
+		default:
+			return false;
+	}
+	getDestCell(state, ki).setConstant(result, width);
+	return true;
+}
+
+bool Executor::bindConstantCompare(KInstruction *ki, ExecutionState &state, const Cell &left, const Cell &right) {
+	if (!left.isConstant() || !right.isConstant() || left.getWidth() != right.getWidth())
+		return false;
+	Expr::Width width = left.getWidth();
+	uint64_t l = left.getConstant(), r = right.getConstant();
+	int64_t sl = signExtendConstant(l, width), sr = signExtendConstant(r, width);
+	bool result;
+	switch (cast<ICmpInst>(ki->inst)->getPredicate()) {
+		case ICmpInst::ICMP_EQ:
+			result = l == r;
+			break;
+		case ICmpInst::ICMP_NE:
+			result = l != r;
+			break;
+		case ICmpInst::ICMP_UGT:
+			result = l > r;
+			break;
+		case ICmpInst::ICMP_UGE:
+			result = l >= r;
+			break;
+		case ICmpInst::ICMP_ULT:
+			result = l < r;
+			break;
+		case ICmpInst::ICMP_ULE:
+			result = l <= r;
+			break;
+		case ICmpInst::ICMP_SGT:
+			result = sl > sr;
+			break;
+		case ICmpInst::ICMP_SGE:
+			result = sl >= sr;
+			break;
+		case ICmpInst::ICMP_SLT:
+			result = sl < sr;
+			break;
+		case ICmpInst::ICMP_SLE:
+			result = sl <= sr;
+			break;
+		default:
+			return false;
+	}
+	getDestCell(state, ki).setConstant(result, Expr::Bool);
+	return true;
+}
+
+bool Executor::bindConstantCast(KInstruction *ki, ExecutionState &state, const Cell &arg) {
+	if (!arg.isConstant())
+		return false;
+	Expr::Width width = getWidthForLLVMType(ki->inst->getType());
+	if (width > Expr::Int64)
+		return false;
+	uint64_t result = arg.getConstant();
+	//Trunc, ZExt, IntToPtr and PtrToInt only need the mask of setConstant
+	if (ki->inst->getOpcode() == Instruction::SExt)
+		result = signExtendConstant(result, arg.getWidth());
+	getDestCell(state, ki).setConstant(result, width);
+	return true;
+}
+
+bool Executor::bindConstantGEP(KGEPInstruction *kgepi, ExecutionState &state) {
+	Expr::Width pointerWidth = Context::get().getPointerWidth();
+	const Cell &base = eval(kgepi, 0, state);
+	if (!base.isConstant() || base.getWidth() != pointerWidth)
+		return false;
+	uint64_t address = base.getConstant();
+	for (std::vector<std::pair<unsigned, uint64_t> >::iterator it = kgepi->indices.begin(), ie = kgepi->indices.end(); it != ie;
+			++it) {
+		const Cell &index = eval(kgepi, it->first, state);
+		if (!index.isConstant())
+			return false;
+		address += (uint64_t) signExtendConstant(index.getConstant(), index.getWidth()) * it->second;
+	}
+	address += kgepi->offset;
+	getDestCell(state, kgepi).setConstant(address, pointerWidth);
+	return true;
 }
 
 ref<Expr> Executor::toUnique(const ExecutionState &state, ref<Expr> &e) {
@@ -1050,6 +1196,7 @@ void Executor::stepInstruction(ExecutionState &state) {
 	++stats::instructions;
 	state.currentThread->prevPC = state.currentThread->pc;
 	++state.currentThread->pc;
+	currentAccess.ki = 0;
 
 	if (stats::instructions == StopAfterNInstructions)
 		haltExecution = true;
@@ -1160,7 +1307,8 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
 				}
 			}
 
-			MemoryObject *mo = sf.varargs = memory->allocate(size, true, false, state.currentThread->prevPC->inst);
+			MemoryObject *mo = sf.varargs = memory->allocate(size, true, false, state.currentThread->prevPC->inst,
+					state.currentThread->threadId);
 			if (!mo) {
 				terminateStateOnExecError(state, "out of memory (varargs)");
 				return;
@@ -1301,7 +1449,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 			ref<Expr> result = ConstantExpr::alloc(0, Expr::Bool);
 
 			if (!isVoidReturn) {
-				result = eval(ki, 0, state).value;
+				result = eval(ki, 0, state).getValue();
 			}
 
 			if (state.currentStack->realStack.size() <= 1) {
@@ -1313,6 +1461,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 					for (std::vector<unsigned>::iterator bi = ji->second.begin(), be = ji->second.end(); bi != be; bi++) {
 						state.swapInThread(*bi, true, false);
 					}
+					state.joinRecord.erase(ji);
 				}
 				state.swapOutThread(state.currentThread, false, false, false, true);
 //				terminateStateOnExit(state);
@@ -1397,7 +1546,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 			} else {
 				// FIXME: Find a way that we don't have this hidden dependency.
 				assert(bi->getCondition() == bi->getOperand(0) && "Wrong operand index!");
-				ref<Expr> cond = eval(ki, 0, state).value;
+				ref<Expr> cond = eval(ki, 0, state).getValue();
 				Executor::StatePair branches = fork(state, cond, false);
 
 				// NOTE: There is a hidden dependency here, markBranchVisited
@@ -1416,7 +1565,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 		}
 		case Instruction::Switch: {
 			SwitchInst *si = cast<SwitchInst>(i);
-			ref<Expr> cond = eval(ki, 0, state).value;
+			ref<Expr> cond = eval(ki, 0, state).getValue();
 			BasicBlock *bb = si->getParent();
 
 			cond = toUnique(state, cond);
@@ -1512,7 +1661,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 			arguments.reserve(numArgs);
 
 			for (unsigned j = 0; j < numArgs; ++j)
-				arguments.push_back(eval(ki, j + 1, state).value);
+				arguments.push_back(eval(ki, j + 1, state).getValue());
 
 			if (f) {
 				const FunctionType *fType = dyn_cast<FunctionType>(cast<PointerType>(f->getType())->getElementType());
@@ -1555,7 +1704,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
 				executeCall(state, ki, f, arguments);
 			} else {
-				ref<Expr> v = eval(ki, 0, state).value;
+				ref<Expr> v = eval(ki, 0, state).getValue();
 
 				ExecutionState *free = &state;
 				bool hasInvalid = false, first = true;
@@ -1596,19 +1745,23 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 		}
 		case Instruction::PHI: {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 0)
-			ref<Expr> result = eval(ki, state.currentThread->incomingBBIndex, state).value;
+			getDestCell(state, ki) = eval(ki, state.currentThread->incomingBBIndex, state);
 #else
-			ref<Expr> result = eval(ki, state.incomingBBIndex * 2, state).value;
+			getDestCell(state, ki) = eval(ki, state.incomingBBIndex * 2, state);
 #endif
-			bindLocal(ki, state, result);
 			break;
 		}
 
 			// Special instructions
 		case Instruction::Select: {
-			ref<Expr> cond = eval(ki, 0, state).value;
-			ref<Expr> tExpr = eval(ki, 1, state).value;
-			ref<Expr> fExpr = eval(ki, 2, state).value;
+			const Cell &condCell = eval(ki, 0, state);
+			if (condCell.isConstant()) {
+				getDestCell(state, ki) = eval(ki, condCell.getConstant() ? 1 : 2, state);
+				break;
+			}
+			ref<Expr> cond = condCell.getValue();
+			ref<Expr> tExpr = eval(ki, 1, state).getValue();
+			ref<Expr> fExpr = eval(ki, 2, state).getValue();
 			ref<Expr> result = SelectExpr::create(cond, tExpr, fExpr);
 			bindLocal(ki, state, result);
 			break;
@@ -1621,103 +1774,106 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 			// Arithmetic / logical
 
 		case Instruction::Add: {
-			ref<Expr> left = eval(ki, 0, state).value;
-			ref<Expr> right = eval(ki, 1, state).value;
-			bindLocal(ki, state, AddExpr::create(left, right));
+			const Cell &left = eval(ki, 0, state);
+			const Cell &right = eval(ki, 1, state);
+			if (!bindConstantBinary(ki, state, left, right))
+				bindLocal(ki, state, AddExpr::create(left.getValue(), right.getValue()));
 			break;
 		}
 
 		case Instruction::Sub: {
-			ref<Expr> left = eval(ki, 0, state).value;
-			ref<Expr> right = eval(ki, 1, state).value;
-			bindLocal(ki, state, SubExpr::create(left, right));
+			const Cell &left = eval(ki, 0, state);
+			const Cell &right = eval(ki, 1, state);
+			if (!bindConstantBinary(ki, state, left, right))
+				bindLocal(ki, state, SubExpr::create(left.getValue(), right.getValue()));
 			break;
 		}
 
 		case Instruction::Mul: {
-			ref<Expr> left = eval(ki, 0, state).value;
-			ref<Expr> right = eval(ki, 1, state).value;
-			bindLocal(ki, state, MulExpr::create(left, right));
+			const Cell &left = eval(ki, 0, state);
+			const Cell &right = eval(ki, 1, state);
+			if (!bindConstantBinary(ki, state, left, right))
+				bindLocal(ki, state, MulExpr::create(left.getValue(), right.getValue()));
 			break;
 		}
 
 		case Instruction::UDiv: {
-			ref<Expr> left = eval(ki, 0, state).value;
-			ref<Expr> right = eval(ki, 1, state).value;
-			ref<Expr> result = UDivExpr::create(left, right);
-			bindLocal(ki, state, result);
+			const Cell &left = eval(ki, 0, state);
+			const Cell &right = eval(ki, 1, state);
+			if (!bindConstantBinary(ki, state, left, right))
+				bindLocal(ki, state, UDivExpr::create(left.getValue(), right.getValue()));
 			break;
 		}
 
 		case Instruction::SDiv: {
-			ref<Expr> left = eval(ki, 0, state).value;
-			ref<Expr> right = eval(ki, 1, state).value;
-			ref<Expr> result = SDivExpr::create(left, right);
-			bindLocal(ki, state, result);
+			const Cell &left = eval(ki, 0, state);
+			const Cell &right = eval(ki, 1, state);
+			if (!bindConstantBinary(ki, state, left, right))
+				bindLocal(ki, state, SDivExpr::create(left.getValue(), right.getValue()));
 			break;
 		}
 
 		case Instruction::URem: {
-			ref<Expr> left = eval(ki, 0, state).value;
-			ref<Expr> right = eval(ki, 1, state).value;
-			ref<Expr> result = URemExpr::create(left, right);
-			bindLocal(ki, state, result);
+			const Cell &left = eval(ki, 0, state);
+			const Cell &right = eval(ki, 1, state);
+			if (!bindConstantBinary(ki, state, left, right))
+				bindLocal(ki, state, URemExpr::create(left.getValue(), right.getValue()));
 			break;
 		}
 
 		case Instruction::SRem: {
-			ref<Expr> left = eval(ki, 0, state).value;
-			ref<Expr> right = eval(ki, 1, state).value;
-			ref<Expr> result = SRemExpr::create(left, right);
-			bindLocal(ki, state, result);
+			const Cell &left = eval(ki, 0, state);
+			const Cell &right = eval(ki, 1, state);
+			if (!bindConstantBinary(ki, state, left, right))
+				bindLocal(ki, state, SRemExpr::create(left.getValue(), right.getValue()));
 			break;
 		}
 
 		case Instruction::And: {
-			ref<Expr> left = eval(ki, 0, state).value;
-			ref<Expr> right = eval(ki, 1, state).value;
-			ref<Expr> result = AndExpr::create(left, right);
-			bindLocal(ki, state, result);
+			const Cell &left = eval(ki, 0, state);
+			const Cell &right = eval(ki, 1, state);
+			if (!bindConstantBinary(ki, state, left, right))
+				bindLocal(ki, state, AndExpr::create(left.getValue(), right.getValue()));
 			break;
 		}
 
 		case Instruction::Or: {
-			ref<Expr> left = eval(ki, 0, state).value;
-			ref<Expr> right = eval(ki, 1, state).value;
-			ref<Expr> result = OrExpr::create(left, right);
-			bindLocal(ki, state, result);
+			const Cell &left = eval(ki, 0, state);
+			const Cell &right = eval(ki, 1, state);
+			if (!bindConstantBinary(ki, state, left, right))
+				bindLocal(ki, state, OrExpr::create(left.getValue(), right.getValue()));
 			break;
 		}
 
 		case Instruction::Xor: {
-			ref<Expr> left = eval(ki, 0, state).value;
-			ref<Expr> right = eval(ki, 1, state).value;
-			ref<Expr> result = XorExpr::create(left, right);
-			bindLocal(ki, state, result);
+			const Cell &left = eval(ki, 0, state);
+			const Cell &right = eval(ki, 1, state);
+			if (!bindConstantBinary(ki, state, left, right))
+				bindLocal(ki, state, XorExpr::create(left.getValue(), right.getValue()));
 			break;
 		}
 
 		case Instruction::Shl: {
-			ref<Expr> left = eval(ki, 0, state).value;
-			ref<Expr> right = eval(ki, 1, state).value;
-			ref<Expr> result = ShlExpr::create(left, right);
-			bindLocal(ki, state, result);
+			const Cell &left = eval(ki, 0, state);
+			const Cell &right = eval(ki, 1, state);
+			if (!bindConstantBinary(ki, state, left, right))
+				bindLocal(ki, state, ShlExpr::create(left.getValue(), right.getValue()));
 			break;
 		}
 
 		case Instruction::LShr: {
-			ref<Expr> left = eval(ki, 0, state).value;
-			ref<Expr> right = eval(ki, 1, state).value;
-			ref<Expr> result = LShrExpr::create(left, right);
-			bindLocal(ki, state, result);
+			const Cell &left = eval(ki, 0, state);
+			const Cell &right = eval(ki, 1, state);
+			if (!bindConstantBinary(ki, state, left, right))
+				bindLocal(ki, state, LShrExpr::create(left.getValue(), right.getValue()));
 			break;
 		}
 
 		case Instruction::AShr: {
-			ref<Expr> left = eval(ki, 0, state).value;
-			ref<Expr> right = eval(ki, 1, state).value;
-			ref<Expr> result = AShrExpr::create(left, right);
-			bindLocal(ki, state, result);
+			const Cell &left = eval(ki, 0, state);
+			const Cell &right = eval(ki, 1, state);
+			if (!bindConstantBinary(ki, state, left, right))
+				bindLocal(ki, state, AShrExpr::create(left.getValue(), right.getValue()));
 			break;
 		}
 
@@ -1727,82 +1883,85 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 			CmpInst *ci = cast<CmpInst>(i);
 			ICmpInst *ii = cast<ICmpInst>(ci);
 
+			if (bindConstantCompare(ki, state, eval(ki, 0, state), eval(ki, 1, state)))
+				break;
+
 			switch (ii->getPredicate()) {
 				case ICmpInst::ICMP_EQ: {
-					ref<Expr> left = eval(ki, 0, state).value;
-					ref<Expr> right = eval(ki, 1, state).value;
+					ref<Expr> left = eval(ki, 0, state).getValue();
+					ref<Expr> right = eval(ki, 1, state).getValue();
 					ref<Expr> result = EqExpr::create(left, right);
 					bindLocal(ki, state, result);
 					break;
 				}
 
 				case ICmpInst::ICMP_NE: {
-					ref<Expr> left = eval(ki, 0, state).value;
-					ref<Expr> right = eval(ki, 1, state).value;
+					ref<Expr> left = eval(ki, 0, state).getValue();
+					ref<Expr> right = eval(ki, 1, state).getValue();
 					ref<Expr> result = NeExpr::create(left, right);
 					bindLocal(ki, state, result);
 					break;
 				}
 
 				case ICmpInst::ICMP_UGT: {
-					ref<Expr> left = eval(ki, 0, state).value;
-					ref<Expr> right = eval(ki, 1, state).value;
+					ref<Expr> left = eval(ki, 0, state).getValue();
+					ref<Expr> right = eval(ki, 1, state).getValue();
 					ref<Expr> result = UgtExpr::create(left, right);
 					bindLocal(ki, state, result);
 					break;
 				}
 
 				case ICmpInst::ICMP_UGE: {
-					ref<Expr> left = eval(ki, 0, state).value;
-					ref<Expr> right = eval(ki, 1, state).value;
+					ref<Expr> left = eval(ki, 0, state).getValue();
+					ref<Expr> right = eval(ki, 1, state).getValue();
 					ref<Expr> result = UgeExpr::create(left, right);
 					bindLocal(ki, state, result);
 					break;
 				}
 
 				case ICmpInst::ICMP_ULT: {
-					ref<Expr> left = eval(ki, 0, state).value;
-					ref<Expr> right = eval(ki, 1, state).value;
+					ref<Expr> left = eval(ki, 0, state).getValue();
+					ref<Expr> right = eval(ki, 1, state).getValue();
 					ref<Expr> result = UltExpr::create(left, right);
 					bindLocal(ki, state, result);
 					break;
 				}
 
 				case ICmpInst::ICMP_ULE: {
-					ref<Expr> left = eval(ki, 0, state).value;
-					ref<Expr> right = eval(ki, 1, state).value;
+					ref<Expr> left = eval(ki, 0, state).getValue();
+					ref<Expr> right = eval(ki, 1, state).getValue();
 					ref<Expr> result = UleExpr::create(left, right);
 					bindLocal(ki, state, result);
 					break;
 				}
 
 				case ICmpInst::ICMP_SGT: {
-					ref<Expr> left = eval(ki, 0, state).value;
-					ref<Expr> right = eval(ki, 1, state).value;
+					ref<Expr> left = eval(ki, 0, state).getValue();
+					ref<Expr> right = eval(ki, 1, state).getValue();
 					ref<Expr> result = SgtExpr::create(left, right);
 					bindLocal(ki, state, result);
 					break;
 				}
 
 				case ICmpInst::ICMP_SGE: {
-					ref<Expr> left = eval(ki, 0, state).value;
-					ref<Expr> right = eval(ki, 1, state).value;
+					ref<Expr> left = eval(ki, 0, state).getValue();
+					ref<Expr> right = eval(ki, 1, state).getValue();
 					ref<Expr> result = SgeExpr::create(left, right);
 					bindLocal(ki, state, result);
 					break;
 				}
 
 				case ICmpInst::ICMP_SLT: {
-					ref<Expr> left = eval(ki, 0, state).value;
-					ref<Expr> right = eval(ki, 1, state).value;
+					ref<Expr> left = eval(ki, 0, state).getValue();
+					ref<Expr> right = eval(ki, 1, state).getValue();
 					ref<Expr> result = SltExpr::create(left, right);
 					bindLocal(ki, state, result);
 					break;
 				}
 
 				case ICmpInst::ICMP_SLE: {
-					ref<Expr> left = eval(ki, 0, state).value;
-					ref<Expr> right = eval(ki, 1, state).value;
+					ref<Expr> left = eval(ki, 0, state).getValue();
+					ref<Expr> right = eval(ki, 1, state).getValue();
 					ref<Expr> result = SleExpr::create(left, right);
 					bindLocal(ki, state, result);
 					break;
@@ -1820,7 +1979,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 			unsigned elementSize = kmodule->targetData->getTypeStoreSize(ai->getAllocatedType());
 			ref<Expr> size = Expr::createPointer(elementSize);
 			if (ai->isArrayAllocation()) {
-				ref<Expr> count = eval(ki, 0, state).value;
+				ref<Expr> count = eval(ki, 0, state).getValue();
 				count = Expr::createZExtToPointerWidth(count);
 				size = MulExpr::create(size, count);
 			}
@@ -1829,7 +1988,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 		}
 
 		case Instruction::Load: {
-			ref<Expr> base = eval(ki, 0, state).value;
+			ref<Expr> base = eval(ki, 0, state).getValue();
 #if DEBUG_RUNTIME
 			llvm::errs() << "Load base : " << base << "\n";
 #endif
@@ -1837,8 +1996,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 			break;
 		}
 		case Instruction::Store: {
-			ref<Expr> base = eval(ki, 1, state).value;
-			ref<Expr> value = eval(ki, 0, state).value;
+			ref<Expr> base = eval(ki, 1, state).getValue();
+			ref<Expr> value = eval(ki, 0, state).getValue();
 #if DEBUG_RUNTIME
 			llvm::errs() << "Store base : " << base << "\n";
 			llvm::errs() << "Store value : " << value << "\n";
@@ -1846,16 +2005,36 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 			executeMemoryOperation(state, true, base, value, 0);
 			break;
 		}
+		case Instruction::AtomicRMW:
+		case Instruction::AtomicCmpXchg: {
+			//threads only switch between instructions, so the read and the write are atomic
+			ref<Expr> base = eval(ki, 0, state).getValue();
+			Cell &dest = getDestCell(state, ki);
+			dest.setValue(ref<Expr>());
+			executeMemoryOperation(state, false, base, 0, ki);
+			//the read binds nothing if it terminated the state
+			ref<Expr> old = dest.getValue();
+			if (old.isNull())
+				break;
+			executeMemoryOperation(state, true, base, getAtomicResult(ki, state, old), 0);
+			break;
+		}
+		case Instruction::Fence: {
+			//every interleaving of whole instructions is sequentially consistent
+			break;
+		}
 
 		case Instruction::GetElementPtr: {
 			KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
-			ref<Expr> base = eval(ki, 0, state).value;
+			if (bindConstantGEP(kgepi, state))
+				break;
+			ref<Expr> base = eval(ki, 0, state).getValue();
 //			llvm::errs() << "kgepi->base : ";
 //			base->dump();
 			for (std::vector<std::pair<unsigned, uint64_t> >::iterator it = kgepi->indices.begin(), ie = kgepi->indices.end(); it != ie;
 					++it) {
 				uint64_t elementSize = it->second;
-				ref<Expr> index = eval(ki, it->first, state).value;
+				ref<Expr> index = eval(ki, it->first, state).getValue();
 //				llvm::errs() << "kgepi->index : ";
 //				index->dump();
 				base = AddExpr::create(base, MulExpr::create(Expr::createSExtToPointerWidth(index), Expr::createPointer(elementSize)));
@@ -1870,41 +2049,50 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 			// Conversion
 		case Instruction::Trunc: {
 			CastInst *ci = cast<CastInst>(i);
-			ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).value, 0, getWidthForLLVMType(ci->getType()));
+			if (bindConstantCast(ki, state, eval(ki, 0, state)))
+				break;
+			ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).getValue(), 0, getWidthForLLVMType(ci->getType()));
 			bindLocal(ki, state, result);
 			break;
 		}
 		case Instruction::ZExt: {
 			CastInst *ci = cast<CastInst>(i);
-			ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).value, getWidthForLLVMType(ci->getType()));
+			if (bindConstantCast(ki, state, eval(ki, 0, state)))
+				break;
+			ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).getValue(), getWidthForLLVMType(ci->getType()));
 			bindLocal(ki, state, result);
 			break;
 		}
 		case Instruction::SExt: {
 			CastInst *ci = cast<CastInst>(i);
-			ref<Expr> result = SExtExpr::create(eval(ki, 0, state).value, getWidthForLLVMType(ci->getType()));
+			if (bindConstantCast(ki, state, eval(ki, 0, state)))
+				break;
+			ref<Expr> result = SExtExpr::create(eval(ki, 0, state).getValue(), getWidthForLLVMType(ci->getType()));
 			bindLocal(ki, state, result);
 			break;
 		}
 
 		case Instruction::IntToPtr: {
 			CastInst *ci = cast<CastInst>(i);
+			if (bindConstantCast(ki, state, eval(ki, 0, state)))
+				break;
 			Expr::Width pType = getWidthForLLVMType(ci->getType());
-			ref<Expr> arg = eval(ki, 0, state).value;
+			ref<Expr> arg = eval(ki, 0, state).getValue();
 			bindLocal(ki, state, ZExtExpr::create(arg, pType));
 			break;
 		}
 		case Instruction::PtrToInt: {
 			CastInst *ci = cast<CastInst>(i);
+			if (bindConstantCast(ki, state, eval(ki, 0, state)))
+				break;
 			Expr::Width iType = getWidthForLLVMType(ci->getType());
-			ref<Expr> arg = eval(ki, 0, state).value;
+			ref<Expr> arg = eval(ki, 0, state).getValue();
 			bindLocal(ki, state, ZExtExpr::create(arg, iType));
 			break;
 		}
 
 		case Instruction::BitCast: {
-			ref<Expr> result = eval(ki, 0, state).value;
-			bindLocal(ki, state, result);
+			getDestCell(state, ki) = eval(ki, 0, state);
 //			llvm::errs() << "BitCast : ";
 //			result->dump();
 			break;
@@ -1913,14 +2101,14 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 			// Floating point instructions
 
 		case Instruction::FAdd: {
-			ref<Expr> originLeft = eval(ki, 0, state).value;
-			ref<Expr> originRight = eval(ki, 1, state).value;
+			ref<Expr> originLeft = eval(ki, 0, state).getValue();
+			ref<Expr> originRight = eval(ki, 1, state).getValue();
 
 			ConstantExpr *leftCE = dyn_cast<ConstantExpr>(originLeft);
 			ConstantExpr *rightCE = dyn_cast<ConstantExpr>(originRight);
 			if (leftCE != NULL && rightCE != NULL) {
-				ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value, "floating point");
-				ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value, "floating point");
+				ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(), "floating point");
+				ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(), "floating point");
 				if (!fpWidthToSemantics(left->getWidth()) || !fpWidthToSemantics(right->getWidth()))
 					return terminateStateOnExecError(state, "Unsupported FAdd operation");
 
@@ -1943,14 +2131,14 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 		}
 
 		case Instruction::FSub: {
-			ref<Expr> originLeft = eval(ki, 0, state).value;
-			ref<Expr> originRight = eval(ki, 1, state).value;
+			ref<Expr> originLeft = eval(ki, 0, state).getValue();
+			ref<Expr> originRight = eval(ki, 1, state).getValue();
 
 			ConstantExpr *leftCE = dyn_cast<ConstantExpr>(originLeft);
 			ConstantExpr *rightCE = dyn_cast<ConstantExpr>(originRight);
 			if (leftCE != NULL && rightCE != NULL) {
-				ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value, "floating point");
-				ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value, "floating point");
+				ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(), "floating point");
+				ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(), "floating point");
 				if (!fpWidthToSemantics(left->getWidth()) || !fpWidthToSemantics(right->getWidth()))
 					return terminateStateOnExecError(state, "Unsupported FSub operation");
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
@@ -1974,14 +2162,14 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 		}
 
 		case Instruction::FMul: {
-			ref<Expr> originLeft = eval(ki, 0, state).value;
-			ref<Expr> originRight = eval(ki, 1, state).value;
+			ref<Expr> originLeft = eval(ki, 0, state).getValue();
+			ref<Expr> originRight = eval(ki, 1, state).getValue();
 
 			ConstantExpr *leftCE = dyn_cast<ConstantExpr>(originLeft);
 			ConstantExpr *rightCE = dyn_cast<ConstantExpr>(originRight);
 			if (leftCE != NULL && rightCE != NULL) {
-				ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value, "floating point");
-				ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value, "floating point");
+				ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(), "floating point");
+				ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(), "floating point");
 				if (!fpWidthToSemantics(left->getWidth()) || !fpWidthToSemantics(right->getWidth()))
 					return terminateStateOnExecError(state, "Unsupported FMul operation");
 
@@ -2009,14 +2197,14 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 		}
 
 		case Instruction::FDiv: {
-			ref<Expr> originLeft = eval(ki, 0, state).value;
-			ref<Expr> originRight = eval(ki, 1, state).value;
+			ref<Expr> originLeft = eval(ki, 0, state).getValue();
+			ref<Expr> originRight = eval(ki, 1, state).getValue();
 
 			ConstantExpr *leftCE = dyn_cast<ConstantExpr>(originLeft);
 			ConstantExpr *rightCE = dyn_cast<ConstantExpr>(originRight);
 			if (leftCE != NULL && rightCE != NULL) {
-				ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value, "floating point");
-				ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value, "floating point");
+				ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(), "floating point");
+				ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(), "floating point");
 				if (!fpWidthToSemantics(left->getWidth()) || !fpWidthToSemantics(right->getWidth()))
 					return terminateStateOnExecError(state, "Unsupported FDiv operation");
 
@@ -2042,14 +2230,14 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 		}
 
 		case Instruction::FRem: {
-			ref<Expr> originLeft = eval(ki, 0, state).value;
-			ref<Expr> originRight = eval(ki, 1, state).value;
+			ref<Expr> originLeft = eval(ki, 0, state).getValue();
+			ref<Expr> originRight = eval(ki, 1, state).getValue();
 
 			ConstantExpr *leftCE = dyn_cast<ConstantExpr>(originLeft);
 			ConstantExpr *rightCE = dyn_cast<ConstantExpr>(originRight);
 			if (leftCE != NULL && rightCE != NULL) {
-				ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value, "floating point");
-				ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value, "floating point");
+				ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(), "floating point");
+				ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(), "floating point");
 				if (!fpWidthToSemantics(left->getWidth()) || !fpWidthToSemantics(right->getWidth()))
 					return terminateStateOnExecError(state, "Unsupported FRem operation");
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
@@ -2074,12 +2262,12 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 		case Instruction::FPTrunc: {
 
 			FPTruncInst *fi = cast<FPTruncInst>(i);
-			ref<Expr> srcExpr = eval(ki, 0, state).value;
+			ref<Expr> srcExpr = eval(ki, 0, state).getValue();
 			ConstantExpr *srcCons = dyn_cast<ConstantExpr>(srcExpr);
 			if (srcCons != NULL) {
 //	  FPTruncInst *fi = cast<FPTruncInst>(i);
 				Expr::Width resultType = getWidthForLLVMType(fi->getType());
-				ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value, "floating point");
+				ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(), "floating point");
 				if (!fpWidthToSemantics(arg->getWidth()) || resultType > arg->getWidth())
 					return terminateStateOnExecError(state, "Unsupported FPTrunc operation");
 
@@ -2095,7 +2283,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 				bindLocal(ki, state, result);
 //    bindLocal(ki, state.currentStack, ConstantExpr::alloc(Res));
 			} else {
-				ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).value, 0, getWidthForLLVMType(fi->getType()));
+				ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).getValue(), 0, getWidthForLLVMType(fi->getType()));
 				result->isFloat = true;
 				bindLocal(ki, state, result);
 			}
@@ -2104,12 +2292,12 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
 		case Instruction::FPExt: {
 			FPExtInst *fi = cast<FPExtInst>(i);
-			ref<Expr> srcExpr = eval(ki, 0, state).value;
+			ref<Expr> srcExpr = eval(ki, 0, state).getValue();
 			ConstantExpr *srcCons = dyn_cast<ConstantExpr>(srcExpr);
 			if (srcCons != NULL) {
 //    FPExtInst *fi = cast<FPExtInst>(i);
 				Expr::Width resultType = getWidthForLLVMType(fi->getType());
-				ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value, "floating point");
+				ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(), "floating point");
 				if (!fpWidthToSemantics(arg->getWidth()) || arg->getWidth() > resultType)
 					return terminateStateOnExecError(state, "Unsupported FPExt operation");
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
@@ -2123,7 +2311,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 				result->isFloat = true;
 				bindLocal(ki, state, result);
 			} else {
-				ref<Expr> result = SExtExpr::create(eval(ki, 0, state).value, getWidthForLLVMType(fi->getType()));
+				ref<Expr> result = SExtExpr::create(eval(ki, 0, state).getValue(), getWidthForLLVMType(fi->getType()));
 				result->isFloat = true;
 				bindLocal(ki, state, result);
 			}
@@ -2132,12 +2320,12 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
 		case Instruction::FPToUI: {
 			FPToUIInst *fi = cast<FPToUIInst>(i);
-			ref<Expr> srcExpr = eval(ki, 0, state).value;
+			ref<Expr> srcExpr = eval(ki, 0, state).getValue();
 			ConstantExpr *srcCons = dyn_cast<ConstantExpr>(srcExpr);
 			if (srcCons != NULL) {
 //    FPToUIInst *fi = cast<FPToUIInst>(i);
 				Expr::Width resultType = getWidthForLLVMType(fi->getType());
-				ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value, "floating point");
+				ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(), "floating point");
 				if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
 					return terminateStateOnExecError(state, "Unsupported FPToUI operation");
 
@@ -2151,7 +2339,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 				Arg.convertToInteger(&value, resultType, false, llvm::APFloat::rmTowardZero, &isExact);
 				bindLocal(ki, state, ConstantExpr::alloc(value, resultType));
 			} else {
-				ref<Expr> result = ExtractExpr::alloc(eval(ki, 0, state).value, 0, getWidthForLLVMType(fi->getType()));
+				ref<Expr> result = ExtractExpr::alloc(eval(ki, 0, state).getValue(), 0, getWidthForLLVMType(fi->getType()));
 				result->isFloat = false;
 				bindLocal(ki, state, result);
 			}
@@ -2161,12 +2349,12 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 		case Instruction::FPToSI: {
 
 			FPToSIInst *fi = cast<FPToSIInst>(i);
-			ref<Expr> srcExpr = eval(ki, 0, state).value;
+			ref<Expr> srcExpr = eval(ki, 0, state).getValue();
 			ConstantExpr *srcCons = dyn_cast<ConstantExpr>(srcExpr);
 			if (srcCons != NULL) {
 //	  FPToSIInst *fi = cast<FPToSIInst>(i);
 				Expr::Width resultType = getWidthForLLVMType(fi->getType());
-				ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value, "floating point");
+				ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(), "floating point");
 				if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
 					return terminateStateOnExecError(state, "Unsupported FPToSI operation");
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
@@ -2180,7 +2368,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 				Arg.convertToInteger(&value, resultType, true, llvm::APFloat::rmTowardZero, &isExact);
 				bindLocal(ki, state, ConstantExpr::alloc(value, resultType));
 			} else {
-				ref<Expr> result = ExtractExpr::alloc(eval(ki, 0, state).value, 0, getWidthForLLVMType(fi->getType()));
+				ref<Expr> result = ExtractExpr::alloc(eval(ki, 0, state).getValue(), 0, getWidthForLLVMType(fi->getType()));
 				result->isFloat = false;
 //			llvm::errs() << "fptosi in exe ";
 //			llvm::errs() << result->getKind() << "\n";
@@ -2192,12 +2380,12 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
 		case Instruction::UIToFP: {
 			UIToFPInst *fi = cast<UIToFPInst>(i);
-			ref<Expr> srcExpr = eval(ki, 0, state).value;
+			ref<Expr> srcExpr = eval(ki, 0, state).getValue();
 			ConstantExpr *srcCons = dyn_cast<ConstantExpr>(srcExpr);
 			if (srcCons != NULL) {
 //    UIToFPInst *fi = cast<UIToFPInst>(i);
 				Expr::Width resultType = getWidthForLLVMType(fi->getType());
-				ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value, "floating point");
+				ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(), "floating point");
 				const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
 				if (!semantics)
 					return terminateStateOnExecError(state, "Unsupported UIToFP operation");
@@ -2208,7 +2396,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 				result->isFloat = true;
 				bindLocal(ki, state, result);
 			} else {
-				ref<Expr> result = SExtExpr::alloc(eval(ki, 0, state).value, getWidthForLLVMType(fi->getType()));
+				ref<Expr> result = SExtExpr::alloc(eval(ki, 0, state).getValue(), getWidthForLLVMType(fi->getType()));
 				result->isFloat = true;
 				bindLocal(ki, state, result);
 			}
@@ -2218,12 +2406,12 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 		case Instruction::SIToFP: {
 			SIToFPInst *fi = cast<SIToFPInst>(i);
 
-			ref<Expr> srcExpr = eval(ki, 0, state).value;
+			ref<Expr> srcExpr = eval(ki, 0, state).getValue();
 			ConstantExpr *srcCons = dyn_cast<ConstantExpr>(srcExpr);
 			if (srcCons != NULL) {
 //	  SIToFPInst *fi = cast<SIToFPInst>(i);
 				Expr::Width resultType = getWidthForLLVMType(fi->getType());
-				ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value, "floating point");
+				ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(), "floating point");
 				const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
 				if (!semantics)
 					return terminateStateOnExecError(state, "Unsupported SIToFP operation");
@@ -2234,7 +2422,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 				result->isFloat = true;
 				bindLocal(ki, state, result);
 			} else {
-				ref<Expr> result = SExtExpr::alloc(eval(ki, 0, state).value, getWidthForLLVMType(fi->getType()));
+				ref<Expr> result = SExtExpr::alloc(eval(ki, 0, state).getValue(), getWidthForLLVMType(fi->getType()));
 				result->isFloat = true;
 				bindLocal(ki, state, result);
 			}
@@ -2243,14 +2431,14 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
 		case Instruction::FCmp: {
 			FCmpInst *fi = cast<FCmpInst>(i);
-			ref<Expr> originLeft = eval(ki, 0, state).value;
-			ref<Expr> originRight = eval(ki, 1, state).value;
+			ref<Expr> originLeft = eval(ki, 0, state).getValue();
+			ref<Expr> originRight = eval(ki, 1, state).getValue();
 			ConstantExpr *leftCE = dyn_cast<ConstantExpr>(originLeft);
 			ConstantExpr *rightCE = dyn_cast<ConstantExpr>(originRight);
 			if (leftCE != NULL && rightCE != NULL) {
 //    FCmpInst *fi = cast<FCmpInst>(i);
-				ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value, "floating point");
-				ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value, "floating point");
+				ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(), "floating point");
+				ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(), "floating point");
 				if (!fpWidthToSemantics(left->getWidth()) || !fpWidthToSemantics(right->getWidth()))
 					return terminateStateOnExecError(state, "Unsupported FCmp operation");
 
@@ -2395,8 +2583,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 		case Instruction::InsertValue: {
 			KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
 
-			ref<Expr> agg = eval(ki, 0, state).value;
-			ref<Expr> val = eval(ki, 1, state).value;
+			ref<Expr> agg = eval(ki, 0, state).getValue();
+			ref<Expr> val = eval(ki, 1, state).getValue();
 
 			ref<Expr> l = NULL, r = NULL;
 			unsigned lOffset = kgepi->offset * 8, rOffset = kgepi->offset * 8 + val->getWidth();
@@ -2422,7 +2610,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 		case Instruction::ExtractValue: {
 			KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
 
-			ref<Expr> agg = eval(ki, 0, state).value;
+			ref<Expr> agg = eval(ki, 0, state).getValue();
 
 			ref<Expr> result = ExtractExpr::create(agg, kgepi->offset * 8, getWidthForLLVMType(i->getType()));
 
@@ -2522,7 +2710,7 @@ void Executor::bindModuleConstants() {
 	kmodule->constantTable = new Cell[kmodule->constants.size()];
 	for (unsigned i = 0; i < kmodule->constants.size(); ++i) {
 		Cell &c = kmodule->constantTable[i];
-		c.value = evalConstant(kmodule->constants[i]);
+		c.setValue(evalConstant(kmodule->constants[i]));
 	}
 }
 
@@ -2640,9 +2828,7 @@ void Executor::run(ExecutionState &initialState) {
 			}
 
 			case Thread::MUTEX_BLOCKED: {
-				//TODO:　死锁检测可以完善
 				Thread* origin = thread;
-				bool deadlock = false;
 				do {
 					std::string errorMsg;
 					bool isBlocked;
@@ -2659,15 +2845,11 @@ void Executor::run(ExecutionState &initialState) {
 							}
 							state.reSchedule();
 							thread = state.getNextThread();
-							if (thread == origin) {
-								if (deadlock) {
-									llvm::errs() << "perhaps deadlock happen\n";
-									isAbleToRun = false;
-									break;
-									//assert(0 && "perhaps deadlock happen");
-								} else {
-									deadlock = true;
-								}
+							std::vector<Thread*> deadlocked;
+							if (thread == origin && state.findDeadlock(deadlocked)) {
+								state.printDeadlock(deadlocked, std::cerr);
+								isAbleToRun = false;
+								break;
 							}
 						} else {
 							state.switchThreadToRunnable(thread);
@@ -2746,6 +2928,18 @@ void Executor::run(ExecutionState &initialState) {
 			updateStates(&state);
 			break;
 		}
+		//threads only block or finish by their own instructions, so a deadlock is found when it forms
+		if (!state.currentThread->isRunnable()) {
+			std::vector<Thread*> deadlocked;
+			if (state.findDeadlock(deadlocked)) {
+				state.printDeadlock(deadlocked, std::cerr);
+				execStatus = RUNTIMEERROR;
+				listenerService->executionFailed(state, ki);
+				terminateState(state);
+				updateStates(&state);
+				break;
+			}
+		}
 		processTimers(&state, MaxInstructionTime);
 
 		if (state.threadScheduler->isSchedulerEmpty()) {
@@ -3060,7 +3254,8 @@ void Executor::executeAlloc(ExecutionState &state, ref<Expr> size, bool isLocal,
 		const ObjectState *reallocFrom) {
 	size = toUnique(state, size);
 	if (ConstantExpr *CE = dyn_cast<ConstantExpr>(size)) {
-		MemoryObject *mo = memory->allocate(CE->getZExtValue(), isLocal, false, state.currentThread->prevPC->inst);
+		MemoryObject *mo = memory->allocate(CE->getZExtValue(), isLocal, false, state.currentThread->prevPC->inst,
+				state.currentThread->threadId);
 		if (!mo) {
 			bindLocal(target, state, ConstantExpr::alloc(0, Context::get().getPointerWidth()));
 		} else {
@@ -3211,37 +3406,38 @@ void Executor::executeMemoryOperation(ExecutionState &state, bool isWrite, ref<E
 			value = state.constraints.simplifyExpr(value);
 	}
 
-	// fast path: single in-bounds resolution
-	ObjectPair op;
-	bool success;
-	solver->setTimeout(coreSolverTimeout);
-	if (!state.currentStack->addressSpace->resolveOne(state, solver, address, op, success)) {
-		address = toConstant(state, address, "resolveOne failure");
-		success = state.currentStack->addressSpace->resolveOne(cast<ConstantExpr>(address), op);
-	}
-	solver->setTimeout(0);
+	// fast path: single in-bounds resolution, usually made by the listeners already
+	const MemoryAccess *access = getMemoryAccess(state, state.currentThread->prevPC, address);
+	address = access->address;
 
-	if (success) {
-		const MemoryObject *mo = op.first;
+	if (access->success) {
+		const MemoryObject *mo = access->mo;
+		ref<Expr> offset = access->offset;
 
-		if (MaxSymArraySize && mo->size >= MaxSymArraySize) {
+		if (MaxSymArraySize && mo->size >= MaxSymArraySize && !isa<ConstantExpr>(address)) {
 			address = toConstant(state, address, "max-sym-array-size");
+			offset = mo->getOffsetExpr(address);
 		}
 
-		ref<Expr> offset = mo->getOffsetExpr(address);
-
 		bool inBounds;
-		solver->setTimeout(coreSolverTimeout);
-		bool success = solver->mustBeTrue(state, mo->getBoundsCheckOffset(offset, bytes), inBounds);
-		solver->setTimeout(0);
-		if (!success) {
-			state.currentThread->pc = state.currentThread->prevPC;
-			terminateStateEarly(state, "Query timed out (bounds check).");
-			return;
+		ref<Expr> boundsCheck = mo->getBoundsCheckOffset(offset, bytes);
+		if (ConstantExpr *CE = dyn_cast<ConstantExpr>(boundsCheck)) {
+			// constant address, no query needed
+			inBounds = CE->isTrue();
+		} else {
+			solver->setTimeout(coreSolverTimeout);
+			bool success = solver->mustBeTrue(state, boundsCheck, inBounds);
+			solver->setTimeout(0);
+			if (!success) {
+				state.currentThread->pc = state.currentThread->prevPC;
+				terminateStateEarly(state, "Query timed out (bounds check).");
+				return;
+			}
 		}
 
 		if (inBounds) {
-			const ObjectState *os = op.second;
+			// the object state may have been replaced since the resolution
+			const ObjectState *os = state.currentStack->addressSpace->findObject(mo);
 			if (isWrite) {
 				if (os->readOnly) {
 					terminateStateOnError(state, "memory error: object read only", "readonly.err");
@@ -3655,6 +3851,77 @@ bool Executor::getMemoryObject(ObjectPair& op, ExecutionState& state, AddressSpa
 	return success;
 }
 
+ref<Expr> Executor::getAtomicResult(KInstruction *ki, ExecutionState &state, ref<Expr> old) {
+	if (isa<AtomicCmpXchgInst>(ki->inst)) {
+		ref<Expr> compare = eval(ki, 1, state).getValue();
+		ref<Expr> value = eval(ki, 2, state).getValue();
+		return SelectExpr::create(EqExpr::create(old, compare), value, old);
+	}
+	AtomicRMWInst *ai = cast<AtomicRMWInst>(ki->inst);
+	ref<Expr> value = eval(ki, 1, state).getValue();
+	switch (ai->getOperation()) {
+		case AtomicRMWInst::Xchg:
+			return value;
+		case AtomicRMWInst::Add:
+			return AddExpr::create(old, value);
+		case AtomicRMWInst::Sub:
+			return SubExpr::create(old, value);
+		case AtomicRMWInst::And:
+			return AndExpr::create(old, value);
+		case AtomicRMWInst::Nand:
+			return NotExpr::create(AndExpr::create(old, value));
+		case AtomicRMWInst::Or:
+			return OrExpr::create(old, value);
+		case AtomicRMWInst::Xor:
+			return XorExpr::create(old, value);
+		case AtomicRMWInst::Max:
+			return SelectExpr::create(SgtExpr::create(old, value), old, value);
+		case AtomicRMWInst::Min:
+			return SelectExpr::create(SltExpr::create(old, value), old, value);
+		case AtomicRMWInst::UMax:
+			return SelectExpr::create(UgtExpr::create(old, value), old, value);
+		case AtomicRMWInst::UMin:
+			return SelectExpr::create(UltExpr::create(old, value), old, value);
+		default:
+			assert(0 && "unknown atomicrmw operation");
+			return value;
+	}
+}
+
+const MemoryAccess* Executor::getMemoryAccess(ExecutionState& state, KInstruction *ki, ref<Expr> address) {
+	AddressSpace *addressSpace = state.currentStack->addressSpace;
+	if (currentAccess.ki == ki && currentAccess.addressSpace == addressSpace && currentAccess.key == address) {
+		return &currentAccess;
+	}
+	currentAccess.ki = ki;
+	currentAccess.addressSpace = addressSpace;
+	currentAccess.key = address;
+
+	ObjectPair op;
+	bool success;
+	solver->setTimeout(coreSolverTimeout);
+	if (!addressSpace->resolveOne(state, solver, address, op, success, ki->resolutionCache)) {
+		address = toConstant(state, address, "resolveOne failure");
+		success = addressSpace->resolveOne(cast<ConstantExpr>(address), op, ki->resolutionCache);
+	}
+	solver->setTimeout(0);
+
+	currentAccess.address = address;
+	currentAccess.success = success;
+	if (success) {
+		currentAccess.mo = op.first;
+		currentAccess.os = op.second;
+		currentAccess.offset = op.first->getOffsetExpr(address);
+		currentAccess.isGlobal = isGlobalMO(op.first);
+	} else {
+		currentAccess.mo = 0;
+		currentAccess.os = 0;
+		currentAccess.offset = ref<Expr>();
+		currentAccess.isGlobal = false;
+	}
+	return &currentAccess;
+}
+
 bool Executor::isGlobalMO(const MemoryObject* mo) {
 	bool result;
 	if (mo->isGlobal) {
@@ -3736,35 +4003,35 @@ void Executor::printInstrcution(ExecutionState &state, KInstruction* ki) {
 				Value *fp = cs.getCalledValue();
 				Function *f = getTargetFunction(fp, state);
 				if (!f) {
-					ref<Expr> expr = eval(ki, 0, state).value;
+					ref<Expr> expr = eval(ki, 0, state).getValue();
 					ConstantExpr* constExpr = dyn_cast<ConstantExpr>(expr);
 					uint64_t functionPtr = constExpr->getZExtValue();
 					f = (Function*) functionPtr;
 				}
 				out << " " << f->getName().str();
 				if (f->getName().str() == "pthread_mutex_lock") {
-					ref<Expr> param = eval(ki, 1, state).value;
+					ref<Expr> param = eval(ki, 1, state).getValue();
 					ConstantExpr* cexpr = dyn_cast<ConstantExpr>(param);
 					out << " " << cexpr->getZExtValue();
 				} else if (f->getName().str() == "pthread_mutex_unlock") {
-					ref<Expr> param = eval(ki, 1, state).value;
+					ref<Expr> param = eval(ki, 1, state).getValue();
 					ConstantExpr* cexpr = dyn_cast<ConstantExpr>(param);
 					out << " " << cexpr->getZExtValue();
 				} else if (f->getName().str() == "pthread_cond_wait") {
 					//get lock
-					ref<Expr> param = eval(ki, 2, state).value;
+					ref<Expr> param = eval(ki, 2, state).getValue();
 					ConstantExpr* cexpr = dyn_cast<ConstantExpr>(param);
 					out << " " << cexpr->getZExtValue();
 					//get cond
-					param = eval(ki, 1, state).value;
+					param = eval(ki, 1, state).getValue();
 					cexpr = dyn_cast<ConstantExpr>(param);
 					out << " " << cexpr->getZExtValue();
 				} else if (f->getName().str() == "pthread_cond_signal") {
-					ref<Expr> param = eval(ki, 1, state).value;
+					ref<Expr> param = eval(ki, 1, state).getValue();
 					ConstantExpr* cexpr = dyn_cast<ConstantExpr>(param);
 					out << " " << cexpr->getZExtValue();
 				} else if (f->getName().str() == "pthread_cond_broadcast") {
-					ref<Expr> param = eval(ki, 1, state).value;
+					ref<Expr> param = eval(ki, 1, state).getValue();
 					ConstantExpr* cexpr = dyn_cast<ConstantExpr>(param);
 					out << " " << cexpr->getZExtValue();
 				}
@@ -3781,7 +4048,7 @@ void Executor::printInstrcution(ExecutionState &state, KInstruction* ki) {
 	if (prefix && prefix->current() + 1 == prefix->end()) {
 		inst->print(errs());
 		Event* event = *prefix->current();
-		ref<Expr> param = eval(ki, 0, state).value;
+		ref<Expr> param = eval(ki, 0, state).getValue();
 		ConstantExpr* condition = dyn_cast<ConstantExpr>(param);
 		if (condition->getAPValue().getBoolValue() != event->brCondition) {
 			llvm::errs() << "\n前缀已被取反\n";
@@ -3814,7 +4081,7 @@ unsigned Executor::executePThreadCreate(ExecutionState &state, KInstruction *ki,
 		Value* threadEntranceFP = calli->getArgOperand(2);
 		Function *threadEntrance = getTargetFunction(threadEntranceFP, state);
 		if (!threadEntrance) {
-			ref<Expr> param = eval(ki, 3, state).value;
+			ref<Expr> param = eval(ki, 3, state).getValue();
 			ConstantExpr* functionPtr = dyn_cast<ConstantExpr>(param);
 			threadEntrance = (Function*) (functionPtr->getZExtValue());
 		}
@@ -74,6 +74,20 @@ namespace klee {
 	class TreeStreamWriter;
 	template<class T> class ref;
 
+	/// The resolution of the address of a load or store. It is made once per
+	/// instruction and shared by the listeners and executeMemoryOperation.
+	struct MemoryAccess {
+			KInstruction *ki;
+			AddressSpace *addressSpace;
+			ref<Expr> key; // the address as given by the caller
+			ref<Expr> address; // the address, concrete if resolveOne had to give up
+			const MemoryObject *mo;
+			const ObjectState *os;
+			ref<Expr> offset;
+			bool isGlobal;
+			bool success;
+	};
+
 	/// \todo Add a context object to keep track of data only live
 	/// during an instruction step. Should contain addedStates,
 	/// removedStates, and haltExecution, among others.
@@ -136,6 +150,10 @@ namespace klee {
 			/// \invariant \ref addedStates and \ref removedStates are disjoint.
 			std::set<ExecutionState*> removedStates;
 
+			/// The resolution of the load or store being executed, see
+			/// getMemoryAccess. Cleared before every instruction.
+			MemoryAccess currentAccess;
+
 			/// When non-empty the Executor is running in "seed" mode. The
 			/// states in this map will be executed in an arbitrary order
 			/// (outside the normal search interface) until they terminate. When
@@ -324,6 +342,19 @@ namespace klee {
 			void bindLocal(KInstruction *target, ExecutionState &state, ref<Expr> value);
 			void bindArgument(KFunction *kf, unsigned index, ExecutionState &state, ref<Expr> value);
 
+			// Fast paths for concrete operands of at most 64 bits, computed on the
+			// inline constants of the cells without building any Expr. They return
+			// false and bind nothing when the operands do not allow it.
+			bool bindConstantBinary(KInstruction *ki, ExecutionState &state, const Cell &left, const Cell &right);
+			bool bindConstantCompare(KInstruction *ki, ExecutionState &state, const Cell &left, const Cell &right);
+			bool bindConstantCast(KInstruction *ki, ExecutionState &state, const Cell &arg);
+			bool bindConstantGEP(KGEPInstruction *kgepi, ExecutionState &state);
+
+			/// The value the atomicrmw or cmpxchg ki writes back when it reads old.
+			/// A failed cmpxchg writes old back, so every atomic is one read and
+			/// one write.
+			ref<Expr> getAtomicResult(KInstruction *ki, ExecutionState &state, ref<Expr> old);
+
 			ref<klee::ConstantExpr> evalConstantExpr(const llvm::ConstantExpr *ce);
 
 			/// Return a unique constant value for the given expression in the
@@ -485,6 +516,12 @@ namespace klee {
 
 			bool isGlobalMO(const MemoryObject* mo);
 
+			/// Resolve address for the load or store ki. The listeners and
+			/// executeMemoryOperation call it for the same instruction and share
+			/// one resolution. success is false if address does not resolve to
+			/// one object.
+			const MemoryAccess* getMemoryAccess(ExecutionState& state, KInstruction *ki, ref<Expr> address);
+
 			TimingSolver* getTimeSolver() {
 				return solver;
 			}
@@ -18,14 +18,102 @@
 
 #include "llvm/Support/CommandLine.h"
 
+#include <sys/mman.h>
+
 using namespace klee;
 
+namespace {
+  llvm::cl::opt<bool>
+  DeterministicAddresses("deterministic-addresses", llvm::cl::init(true),
+                         llvm::cl::desc("Give every allocation the same "
+                                        "address in every execution "
+                                        "(default=on)"));
+
+  /// Address space reserved for the arena. Only the pages that external
+  /// calls touch are ever backed.
+  const uint64_t ArenaSize = 1ULL << 34;
+  /// Where the arena is asked to be mapped, so that addresses also agree
+  /// between processes.
+  const uint64_t ArenaHint = 0x200000000000ULL;
+  const uint64_t ArenaAlignment = 16;
+
+  /// The arena, shared by all MemoryManagers.
+  struct Arena {
+    uint64_t base, next, end;
+    /// Address and size given to each allocation, per site and thread,
+    /// indexed by occurrence.
+    llvm::DenseMap<std::pair<const llvm::Value*, unsigned>,
+                   MemoryManager::placements_ty*> sites;
+
+    Arena() : base(0), next(0), end(0) {
+      void *p = mmap((void *) ArenaHint, ArenaSize, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (p == MAP_FAILED) {
+        klee_warning("cannot map the allocation arena, addresses will "
+                     "differ between executions");
+        return;
+      }
+      if ((uint64_t) p != ArenaHint)
+        klee_warning("allocation arena mapped at %p, addresses will differ "
+                     "between processes", p);
+      base = next = (uint64_t) p;
+      end = base + ArenaSize;
+    }
+
+    bool contains(uint64_t address) const {
+      return address >= base && address < end;
+    }
+
+    /// A bump allocation, 0 if the arena is full.
+    uint64_t bump(uint64_t size) {
+      uint64_t aligned = (size + ArenaAlignment - 1) & ~(ArenaAlignment - 1);
+      if (!aligned)
+        aligned = ArenaAlignment;
+      if (!base || aligned > end - next)
+        return 0;
+      uint64_t address = next;
+      next += aligned;
+      return address;
+    }
+
+    MemoryManager::placements_ty *
+    getPlacements(const std::pair<const llvm::Value*, unsigned> &site) {
+      MemoryManager::placements_ty *&placements = sites[site];
+      if (!placements)
+        placements = new MemoryManager::placements_ty();
+      return placements;
+    }
+
+    /// The address of an occurrence, the same as in former executions
+    /// unless it needs more space than before.
+    uint64_t place(MemoryManager::placements_ty &placements,
+                   unsigned occurrence, uint64_t size) {
+      if (occurrence < placements.size() &&
+          size <= placements[occurrence].second)
+        return placements[occurrence].first;
+      uint64_t address = bump(size);
+      if (!address)
+        return 0;
+      if (occurrence < placements.size())
+        placements[occurrence] = std::make_pair(address, size);
+      else if (occurrence == placements.size())
+        placements.push_back(std::make_pair(address, size));
+      return address;
+    }
+  };
+
+  Arena &getArena() {
+    static Arena arena;
+    return arena;
+  }
+}
+
 /***/
 
 MemoryManager::~MemoryManager() { 
   while (!objects.empty()) {
     MemoryObject *mo = *objects.begin();
-    if (!mo->isFixed)
+    if (!mo->isFixed && !getArena().contains(mo->address))
       free((void *)mo->address);
     objects.erase(mo);
     delete mo;
@@ -34,11 +122,22 @@ MemoryManager::~MemoryManager() {
 
 MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal, 
                                       bool isGlobal,
-                                      const llvm::Value *allocSite) {
+                                      const llvm::Value *allocSite,
+                                      unsigned threadId) {
   if (size>10*1024*1024)
     klee_warning_once(0, "Large alloc: %u bytes.  KLEE may run out of memory.", (unsigned) size);
   
-  uint64_t address = (uint64_t) (unsigned long) malloc((unsigned) size);
+  uint64_t address = 0;
+  if (DeterministicAddresses) {
+    std::pair<const llvm::Value*, unsigned> site(allocSite, threadId);
+    Cursor &cursor = cursors[site];
+    if (!cursor.placements)
+      cursor.placements = getArena().getPlacements(site);
+    address = getArena().place(*cursor.placements, cursor.next++, size);
+  }
+  // the arena is full or disabled
+  if (!address)
+    address = (uint64_t) (unsigned long) malloc((unsigned) size);
   if (!address)
     return 0;
   
@@ -74,8 +173,14 @@ void MemoryManager::deallocate(const MemoryObject *mo) {
 void MemoryManager::markFreed(MemoryObject *mo) {
   if (objects.find(mo) != objects.end())
   {
-    if (!mo->isFixed)
+    if (!mo->isFixed && !getArena().contains(mo->address))
       free((void *)mo->address);
     objects.erase(mo);
   }
 }
+
+bool MemoryManager::hasStableAddress(const MemoryObject *mo) {
+  // a fixed object is at the address of its external, an object out of the
+  // arena may be at the address of a freed one
+  return mo->isFixed || getArena().contains(mo->address);
+}
@@ -10,7 +10,10 @@
 #ifndef KLEE_MEMORYMANAGER_H
 #define KLEE_MEMORYMANAGER_H
 
+#include "llvm/ADT/DenseMap.h"
+
 #include <set>
+#include <vector>
 #include <stdint.h>
 
 namespace llvm {
@@ -21,23 +24,46 @@ namespace klee {
   class MemoryObject;
   class ArrayCache;
 
+  /// Allocations are placed in an arena that lives as long as the process.
+  /// The n-th allocation of a site by a thread gets the same address in
+  /// every execution, so that names built from addresses can be compared
+  /// across executions.
   class MemoryManager {
   private:
     typedef std::set<MemoryObject*> objects_ty;
     objects_ty objects;
     ArrayCache *const arrayCache;
 
+  public:
+    /// Address and size of the n-th allocation of a site by a thread.
+    typedef std::vector<std::pair<uint64_t, uint64_t> > placements_ty;
+
+  private:
+    /// The placements of a site and thread, and how many of them this
+    /// execution has used.
+    struct Cursor {
+      placements_ty *placements;
+      unsigned next;
+      Cursor() : placements(0), next(0) {}
+    };
+    llvm::DenseMap<std::pair<const llvm::Value*, unsigned>, Cursor> cursors;
+
   public:
     MemoryManager(ArrayCache *arrayCache) : arrayCache(arrayCache) {}
     ~MemoryManager();
 
     MemoryObject *allocate(uint64_t size, bool isLocal, bool isGlobal,
-                           const llvm::Value *allocSite);
+                           const llvm::Value *allocSite,
+                           unsigned threadId = 0);
     MemoryObject *allocateFixed(uint64_t address, uint64_t size,
                                 const llvm::Value *allocSite);
     void deallocate(const MemoryObject *mo);
     void markFreed(MemoryObject *mo);
     ArrayCache *getArrayCache() const { return arrayCache; }
+
+    /// Whether mo has the same address in every execution, so that its
+    /// address alone identifies it.
+    static bool hasStableAddress(const MemoryObject *mo);
   };
 
 } // End klee namespace
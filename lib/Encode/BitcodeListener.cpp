@@ -13,6 +13,7 @@ namespace klee {
 
 	BitcodeListener::BitcodeListener(RuntimeDataManager* rdManager) :
 			kind(defaultKind), rdManager(rdManager) {
+		listenAll();
 //		stack[1] = new StackType(&addressSpace);
 //		stack[1]->realStack.reserve(10);
 	}
@@ -24,4 +25,26 @@ namespace klee {
 //			}
 //		}
 	}
+
+	void BitcodeListener::listenAll() {
+		for (unsigned i = 0; i < llvm::Instruction::OtherOpsEnd; i++) {
+			listenBefore[i] = true;
+			listenAfter[i] = true;
+		}
+	}
+
+	void BitcodeListener::listenNone() {
+		for (unsigned i = 0; i < llvm::Instruction::OtherOpsEnd; i++) {
+			listenBefore[i] = false;
+			listenAfter[i] = false;
+		}
+	}
+
+	void BitcodeListener::listenBeforeOpcode(unsigned opcode) {
+		listenBefore[opcode] = true;
+	}
+
+	void BitcodeListener::listenAfterOpcode(unsigned opcode) {
+		listenAfter[opcode] = true;
+	}
 }
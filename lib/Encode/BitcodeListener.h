@@ -9,6 +9,7 @@
 #define BITCODELISTENER_H_
 
 #include "klee/ExecutionState.h"
+#include "llvm/IR/Instruction.h"
 #include "../Core/AddressSpace.h"
 #include "../Encode/RuntimeDataManager.h"
 #include "../Thread/StackType.h"
@@ -38,6 +39,19 @@ class BitcodeListener {
 
 		RuntimeDataManager* rdManager;
 
+		//the opcodes beforeExecuteInstruction and afterExecuteInstruction are
+		//called for, a new listener is called for every instruction.
+		//ListenerService reads them in pushListener, so change them in the constructor.
+		//a listener called before an instruction records its event in the trace,
+		//ListenerService records the events of the opcodes no listener wants.
+		bool listenBefore[llvm::Instruction::OtherOpsEnd];
+		bool listenAfter[llvm::Instruction::OtherOpsEnd];
+
+		void listenAll();
+		void listenNone();
+		void listenBeforeOpcode(unsigned opcode);
+		void listenAfterOpcode(unsigned opcode);
+
 //		AddressSpace addressSpace;
 //		std::map<unsigned, StackType*> stack;
 
@@ -7,154 +7,434 @@
 
 #include "DTAM.h"
 
+#include <llvm/Support/CommandLine.h>
+#include <pthread.h>
+#include <algorithm>
 #include <iostream>
 #include <iterator>
 #include <utility>
 #include <vector>
 
+//the vector clocks are compared with SSE4.1 or AVX2 if the cpu has them, the
+//compiler has to support target attributes and __builtin_cpu_supports
+#if (defined(__x86_64__) || defined(__i386__)) && \
+	((defined(__clang__) && (__clang_major__ > 3 || (__clang_major__ == 3 && __clang_minor__ >= 8))) || \
+	(!defined(__clang__) && defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define DTAM_SIMD_DISPATCH 1
+#include <immintrin.h>
+#else
+#define DTAM_SIMD_DISPATCH 0
+#endif
+
 #include "../../include/klee/Expr.h"
 #include "../../include/klee/util/Ref.h"
 #include "Event.h"
 
+#define CLOCK_ALIGN 8
+//smaller frontiers are expanded by the calling thread alone
+#define PARALLEL_FRONTIER 1024
+
+using namespace llvm;
+
+namespace {
+	cl::opt<unsigned> DTAMThreads("dtam-threads", cl::init(1),
+			cl::desc("Threads that propagate the taint of DTAM, frontier by frontier (default=1)"));
+
+	cl::opt<bool> DTAMIncremental("dtam-incremental", cl::init(false),
+			cl::desc("Reuse the taint of the points a trace shares with the last trace (default=off)"));
+}
+
 namespace klee {
 
+//one slice of the current frontier, next collects the points it taints
+struct PropagateWork {
+	const unsigned *edgeBegin;
+	const unsigned *edge;
+	char *isTaint;
+	const unsigned *frontier;
+	unsigned begin, end;
+	std::vector<unsigned> next;
+};
+
+static void *propagateFrontier(void *arg) {
+	PropagateWork *work = (PropagateWork *) arg;
+	for (unsigned i = work->begin; i < work->end; i++) {
+		unsigned point = work->frontier[i];
+		for (unsigned j = work->edgeBegin[point], je = work->edgeBegin[point + 1]; j < je; j++) {
+			unsigned target = work->edge[j];
+			//only the thread that sets the bit puts the point into its frontier
+			if (!work->isTaint[target] && __sync_bool_compare_and_swap(&work->isTaint[target], 0, 1)) {
+				work->next.push_back(target);
+			}
+		}
+	}
+	return NULL;
+}
+
+static double costSince(struct timeval &begin) {
+	struct timeval end;
+	gettimeofday(&end, NULL);
+	return (double) (end.tv_sec * 1000000UL + end.tv_usec - begin.tv_sec * 1000000UL - begin.tv_usec) / 1000000UL;
+}
+
+//one <= two in the components from i on, equal is cleared if they differ
+static bool lessEqualClockTail(const unsigned *one, const unsigned *two, unsigned i, unsigned size, bool &equal) {
+	for (; i < size; i++) {
+		if (one[i] > two[i]) {
+			return false;
+		}
+		if (one[i] != two[i]) {
+			equal = false;
+		}
+	}
+	return true;
+}
+
+//one <= two in every component, equal is set if the clocks are the same
+static bool lessEqualClockScalar(const unsigned *one, const unsigned *two, unsigned size, bool &equal) {
+	equal = true;
+	return lessEqualClockTail(one, two, 0, size, equal);
+}
+
+#if DTAM_SIMD_DISPATCH
+__attribute__((target("avx2")))
+static bool lessEqualClockAVX2(const unsigned *one, const unsigned *two, unsigned size, bool &equal) {
+	unsigned i = 0;
+	equal = true;
+	for (; i + 8 <= size; i += 8) {
+		__m256i a = _mm256_loadu_si256((const __m256i *) (one + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *) (two + i));
+		//a <= b iff max(a, b) == b
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_max_epu32(a, b), b)) != -1) {
+			return false;
+		}
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(a, b)) != -1) {
+			equal = false;
+		}
+	}
+	return lessEqualClockTail(one, two, i, size, equal);
+}
+
+__attribute__((target("sse4.1")))
+static bool lessEqualClockSSE41(const unsigned *one, const unsigned *two, unsigned size, bool &equal) {
+	unsigned i = 0;
+	equal = true;
+	for (; i + 4 <= size; i += 4) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (one + i));
+		__m128i b = _mm_loadu_si128((const __m128i *) (two + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_max_epu32(a, b), b)) != 0xFFFF) {
+			return false;
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, b)) != 0xFFFF) {
+			equal = false;
+		}
+	}
+	return lessEqualClockTail(one, two, i, size, equal);
+}
+#endif
+
+typedef bool (*ClockCompare)(const unsigned *one, const unsigned *two, unsigned size, bool &equal);
+
+static ClockCompare selectLessEqualClock() {
+#if DTAM_SIMD_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return lessEqualClockAVX2;
+	}
+	if (__builtin_cpu_supports("sse4.1")) {
+		return lessEqualClockSSE41;
+	}
+#endif
+	return lessEqualClockScalar;
+}
+
+static const ClockCompare lessEqualClock = selectLessEqualClock();
+
+static DTAMCache* getDTAMCache(RuntimeDataManager* data) {
+	if (DTAMIncremental && !data->dtamCache) {
+		data->dtamCache = new DTAMCache();
+	}
+	return data->dtamCache;
+}
+
 DTAM::DTAM(RuntimeDataManager* data) :
-		runtimeData(data) {
+		runtimeData(data), cache(getDTAMCache(data)) {
 	trace = runtimeData->getCurrentTrace();
 	cost = 0;
+	clockStride = 0;
 }
 
 DTAM::~DTAM() {
 
 }
 
+unsigned DTAM::addPoint(Event *event, bool write) {
+	unsigned point = pointName.size();
+	pointName.push_back(event->globalName);
+	DTAMKey key;
+	key.threadId = event->threadId;
+	key.threadEventId = event->threadEventId;
+	key.inst = event->inst;
+	pointKey.push_back(key);
+	isWrite.push_back(write);
+	isTaint.push_back(false);
+	clocks.resize(clocks.size() + clockStride, 0);
+	std::copy(event->vectorClock.begin(), event->vectorClock.end(), clocks.begin() + point * clockStride);
+	return point;
+}
+
+//the access of one is ordered before the access of two
+bool DTAM::happensBefore(unsigned one, unsigned two) {
+	bool equal;
+	return lessEqualClock(&clocks[one * clockStride], &clocks[two * clockStride], clockStride, equal) && !equal;
+}
+
 void DTAM::DTAMParallel() {
 
+	pointName.clear();
+	pointKey.clear();
+	isWrite.clear();
+	isTaint.clear();
+	clocks.clear();
+	unsigned clockSize = 0;
+	for (std::map<std::string, std::vector<Event *> >::iterator it = trace->allReadSet.begin(), ie =
+			trace->allReadSet.end(); it != ie; it++) {
+		for (std::vector<Event *>::iterator itt = it->second.begin(), iee = it->second.end(); itt != iee; itt++) {
+			clockSize = std::max(clockSize, (unsigned) (*itt)->vectorClock.size());
+		}
+	}
+	for (std::map<std::string, std::vector<Event *> >::iterator it = trace->allWriteSet.begin(), ie =
+			trace->allWriteSet.end(); it != ie; it++) {
+		for (std::vector<Event *>::iterator itt = it->second.begin(), iee = it->second.end(); itt != iee; itt++) {
+			clockSize = std::max(clockSize, (unsigned) (*itt)->vectorClock.size());
+		}
+	}
+	clockStride = (clockSize + CLOCK_ALIGN - 1) / CLOCK_ALIGN * CLOCK_ALIGN;
+
+	std::map<std::string, unsigned> allRead;
 	for (std::map<std::string, std::vector<Event *> >::iterator it = trace->allReadSet.begin(), ie =
 			trace->allReadSet.end(); it != ie; it++) {
-		std::vector<Event *> var = (*it).second;
+		std::vector<Event *> &var = (*it).second;
 		for (std::vector<Event *>::iterator itt = var.begin(), iee = var.end(); itt != iee; itt++) {
 			std::string globalVarFullName = (*itt)->globalName;
-			DTAMPoint *point = new DTAMPoint(globalVarFullName, (*itt)->vectorClock);
-			allRead[globalVarFullName] = point;
+			if (allRead.find(globalVarFullName) == allRead.end()) {
+				allRead[globalVarFullName] = addPoint(*itt, false);
+			}
 		}
 	}
 
+	//(from, to): the taint of from flows to to
+	std::vector<std::pair<unsigned, unsigned> > edges;
+	std::set<std::string> allWrite;
 	for (std::map<std::string, std::vector<Event *> >::iterator it = trace->allWriteSet.begin(), ie =
 			trace->allWriteSet.end(); it != ie; it++) {
-		std::vector<Event *> var = (*it).second;
+		std::vector<Event *> &var = (*it).second;
 		for (std::vector<Event *>::iterator itt = var.begin(), iee = var.end(); itt != iee; itt++) {
 			std::string globalVarFullName = (*itt)->globalName;
-			DTAMPoint *point = new DTAMPoint(globalVarFullName, (*itt)->vectorClock);
+			if (!allWrite.insert(globalVarFullName).second) {
+				continue;
+			}
+			unsigned point = addPoint(*itt, true);
+			//the reads the written value is computed from
 			for (std::vector<ref<klee::Expr> >::iterator ittt = (*itt)->relatedSymbolicExpr.begin(), ieee =
 					(*itt)->relatedSymbolicExpr.end(); ittt != ieee; ittt++) {
-				std::string value = FilterSymbolicExpr::getGlobalName(*ittt);
-				point->affectedPoint.push_back(allRead[value]);
-				allRead[value]->affectingPoint.push_back(point);
+				std::map<std::string, unsigned>::iterator read = allRead.find(FilterSymbolicExpr::getGlobalName(*ittt));
+				if (read != allRead.end()) {
+					edges.push_back(std::make_pair(read->second, point));
+				}
 			}
-			std::string varName = (*itt)->name;
-			for (std::vector<Event *>::iterator ittt = trace->allReadSet[varName].begin(), ieee =
-					trace->allReadSet[varName].end(); ittt != ieee; ittt++) {
-				std::string value = (*ittt)->globalName;
-				point->affectingPoint.push_back(allRead[value]);
-				allRead[value]->affectedPoint.push_back(point);
+			//the reads that may read the written value
+			std::map<std::string, std::vector<Event *> >::iterator reads = trace->allReadSet.find((*itt)->name);
+			if (reads == trace->allReadSet.end()) {
+				continue;
+			}
+			for (std::vector<Event *>::iterator ittt = reads->second.begin(), ieee = reads->second.end(); ittt != ieee;
+					ittt++) {
+				std::map<std::string, unsigned>::iterator read = allRead.find((*ittt)->globalName);
+				if (read != allRead.end()) {
+					edges.push_back(std::make_pair(point, read->second));
+				}
 			}
-			allWrite[globalVarFullName] = point;
 		}
 	}
 
+	//counting sort of the edges by their source
+	edgeBegin.assign(pointName.size() + 1, 0);
+	for (unsigned i = 0; i < edges.size(); i++) {
+		edgeBegin[edges[i].first + 1]++;
+	}
+	for (unsigned i = 1; i < edgeBegin.size(); i++) {
+		edgeBegin[i] += edgeBegin[i - 1];
+	}
+	std::vector<unsigned> next(edgeBegin.begin(), edgeBegin.end() - 1);
+	edge.resize(edges.size());
+	for (unsigned i = 0; i < edges.size(); i++) {
+		edge[next[edges[i].first]++] = edges[i].second;
+	}
+
 }
 
+//drop the edges from a write to the reads that happen before it.
+//the kept edges are copied into new arrays in one pass.
 void DTAM::DTAMhybrid() {
 
-	for (std::map<std::string, DTAMPoint*>::iterator it = allWrite.begin(), ie = allWrite.end(); it != ie; it++) {
-		DTAMPoint *point = (*it).second;
-		std::string name = point->name;
-		for (std::vector<DTAMPoint*>::iterator itt = point->affectingPoint.begin(); itt < point->affectingPoint.end();
-				) {
-			if ((*point) <= (*itt)) {
-				itt++;
-			} else {
-				for (std::vector<DTAMPoint*>::iterator ittt = (*itt)->affectingPoint.begin();
-						ittt < (*itt)->affectingPoint.end(); ittt++) {
-					if (*ittt == point) {
-						(*itt)->affectedPoint.erase(ittt);
-					}
-				}
-				point->affectingPoint.erase(itt);
+	if (edgeBegin.empty()) {
+		return;
+	}
+	std::vector<unsigned> filteredBegin(edgeBegin.size(), 0);
+	std::vector<unsigned> filtered;
+	filtered.reserve(edge.size());
+	for (unsigned i = 0; i + 1 < edgeBegin.size(); i++) {
+		filteredBegin[i] = filtered.size();
+		for (unsigned j = edgeBegin[i]; j < edgeBegin[i + 1]; j++) {
+			if (isWrite[i] && happensBefore(edge[j], i)) {
+				continue;
 			}
+			filtered.push_back(edge[j]);
 		}
 	}
+	filteredBegin.back() = filtered.size();
+	edgeBegin.swap(filteredBegin);
+	edge.swap(filtered);
 }
 
-void DTAM::initTaint(std::vector<DTAMPoint*> &remainPoint) {
+void DTAM::initTaint(std::vector<unsigned> &remainPoint) {
 
 	remainPoint.clear();
 
-	for (std::map<std::string, DTAMPoint*>::iterator it = allWrite.begin(), ie = allWrite.end(); it != ie; it++) {
-		DTAMPoint *point = (*it).second;
-		std::string name = point->name;
-		if (trace->DTAMSerial.find(name) != trace->DTAMSerial.end()) {
-			point->isTaint = true;
-			remainPoint.push_back(point);
+	for (unsigned i = 0; i < pointName.size(); i++) {
+		if (trace->DTAMSerial.find(pointName[i]) != trace->DTAMSerial.end()) {
+			isTaint[i] = true;
+			remainPoint.push_back(i);
 		} else {
-			point->isTaint = false;
+			isTaint[i] = false;
 		}
 	}
 
-	for (std::map<std::string, DTAMPoint*>::iterator it = allRead.begin(), ie = allRead.end(); it != ie; it++) {
-		DTAMPoint *point = (*it).second;
-		std::string name = point->name;
-		if (trace->DTAMSerial.find(name) != trace->DTAMSerial.end()) {
-			point->isTaint = true;
-			remainPoint.push_back(point);
-		} else {
-			point->isTaint = false;
+}
+
+void DTAM::propagateTaint(std::vector<unsigned> &remainPoint) {
+
+	unsigned threadNum = DTAMThreads ? DTAMThreads : 1;
+	std::vector<PropagateWork> works(threadNum);
+	std::vector<pthread_t> threads(threadNum);
+	while (!remainPoint.empty()) {
+		unsigned used = remainPoint.size() < PARALLEL_FRONTIER ? 1 : threadNum;
+		unsigned chunk = (remainPoint.size() + used - 1) / used;
+		for (unsigned k = 0; k < used; k++) {
+			PropagateWork &work = works[k];
+			work.edgeBegin = &edgeBegin[0];
+			work.edge = edge.empty() ? NULL : &edge[0];
+			work.isTaint = &isTaint[0];
+			work.frontier = &remainPoint[0];
+			work.begin = std::min((unsigned) remainPoint.size(), k * chunk);
+			work.end = std::min((unsigned) remainPoint.size(), (k + 1) * chunk);
+			work.next.clear();
+		}
+		for (unsigned k = 1; k < used; k++) {
+			pthread_create(&threads[k], NULL, propagateFrontier, &works[k]);
+		}
+		propagateFrontier(&works[0]);
+		for (unsigned k = 1; k < used; k++) {
+			pthread_join(threads[k], NULL);
+		}
+		remainPoint.clear();
+		for (unsigned k = 0; k < used; k++) {
+			remainPoint.insert(remainPoint.end(), works[k].next.begin(), works[k].next.end());
 		}
 	}
-
 }
 
-void DTAM::propagateTaint(std::vector<DTAMPoint*> &remainPoint) {
+/*
+ * the points whose seed flag and incoming edges differ from the last trace
+ * and all points they reach are dirty, the others take their taint from the
+ * cache. only the dirty part is propagated again.
+ */
+void DTAM::reuseTaint(std::vector<unsigned> &remainPoint, DTAMCache::Graph graph) {
 
-	std::vector<DTAMPoint*>::iterator it;
-	while (!remainPoint.empty()) {
-		it = remainPoint.end();
-		it--;
-		DTAMPoint *point = (*it);
-		remainPoint.pop_back();
-		for (std::vector<DTAMPoint*>::iterator itt = point->affectingPoint.begin(), iee = point->affectingPoint.end();
-				itt < iee; itt++) {
-			if (!(*itt)->isTaint) {
-				(*itt)->isTaint = true;
-				remainPoint.push_back((*itt));
+	if (!cache) {
+		return;
+	}
+	unsigned size = pointName.size();
+	isSeed.assign(isTaint.begin(), isTaint.end());
+	incoming.assign(size, std::vector<DTAMKey>());
+	for (unsigned i = 0; i < size; i++) {
+		for (unsigned j = edgeBegin[i]; j < edgeBegin[i + 1]; j++) {
+			incoming[edge[j]].push_back(pointKey[i]);
+		}
+	}
+
+	std::vector<char> dirty(size, 0);
+	std::vector<unsigned> worklist;
+	std::vector<DTAMCache::Entry*> entries(size, NULL);
+	for (unsigned i = 0; i < size; i++) {
+		std::sort(incoming[i].begin(), incoming[i].end());
+		entries[i] = cache->lookup(pointKey[i]);
+		if (!entries[i] || entries[i]->seed != (bool) isSeed[i] || entries[i]->incoming[graph] != incoming[i]) {
+			dirty[i] = 1;
+			worklist.push_back(i);
+		}
+	}
+	while (!worklist.empty()) {
+		unsigned point = worklist.back();
+		worklist.pop_back();
+		for (unsigned j = edgeBegin[point]; j < edgeBegin[point + 1]; j++) {
+			if (!dirty[edge[j]]) {
+				dirty[edge[j]] = 1;
+				worklist.push_back(edge[j]);
 			}
 		}
 	}
+
+	for (unsigned i = 0; i < size; i++) {
+		if (dirty[i]) {
+			cache->recomputedPointNum++;
+		} else {
+			isTaint[i] = entries[i]->taint[graph];
+			cache->reusedPointNum++;
+		}
+	}
+	//only the tainted points next to the dirty part have to be expanded
+	remainPoint.clear();
+	for (unsigned i = 0; i < size; i++) {
+		if (!isTaint[i]) {
+			continue;
+		}
+		bool expand = dirty[i];
+		for (unsigned j = edgeBegin[i]; !expand && j < edgeBegin[i + 1]; j++) {
+			expand = dirty[edge[j]];
+		}
+		if (expand) {
+			remainPoint.push_back(i);
+		}
+	}
 }
 
-void DTAM::getTaint(std::set<std::string> &taint) {
+void DTAM::recordTaint(DTAMCache::Graph graph) {
 
-	for (std::map<std::string, DTAMPoint*>::iterator it = allWrite.begin(), ie = allWrite.end(); it != ie; it++) {
-		DTAMPoint *point = (*it).second;
-		if (point->isTaint == true) {
-			std::string name = point->name;
-			taint.insert(name);
-		}
+	if (!cache) {
+		return;
+	}
+	for (unsigned i = 0; i < pointName.size(); i++) {
+		DTAMCache::Entry &entry = cache->record(pointKey[i]);
+		entry.seed = isSeed[i];
+		entry.incoming[graph].swap(incoming[i]);
+		entry.taint[graph] = isTaint[i];
 	}
+}
 
-	for (std::map<std::string, DTAMPoint*>::iterator it = allRead.begin(), ie = allRead.end(); it != ie; it++) {
-		DTAMPoint *point = (*it).second;
-		if (point->isTaint == true) {
-			std::string name = point->name;
-			taint.insert(name);
+void DTAM::getTaint(std::set<std::string> &taint) {
+
+	for (unsigned i = 0; i < pointName.size(); i++) {
+		if (isTaint[i]) {
+			taint.insert(pointName[i]);
 		}
 	}
 }
 
 void DTAM::dtam() {
 
-	std::vector<DTAMPoint*> remainPoint;
+	std::vector<unsigned> remainPoint;
 
 	for (std::set<std::string>::iterator it = trace->DTAMSerial.begin(), ie = trace->DTAMSerial.end(); it != ie; it++) {
 		std::string name = (*it);
@@ -164,10 +444,17 @@ void DTAM::dtam() {
 	runtimeData->DTAMSerialMap.push_back(trace->DTAMSerialMap.size());
 	runtimeData->DTAMSerial.push_back(trace->DTAMSerial.size());
 
+	struct timeval phase;
 	gettimeofday(&start, NULL);
+	gettimeofday(&phase, NULL);
 	DTAMParallel();
+	runtimeData->DTAMGraphCost += costSince(phase);
 	initTaint(remainPoint);
+	gettimeofday(&phase, NULL);
+	reuseTaint(remainPoint, DTAMCache::Parallel);
 	propagateTaint(remainPoint);
+	recordTaint(DTAMCache::Parallel);
+	runtimeData->DTAMPropagateCost += costSince(phase);
 	getTaint(trace->DTAMParallel);
 	std::set<std::string> &potentialTaint = trace->potentialTaint;
 	for (std::set<std::string>::iterator it = trace->DTAMParallel.begin(), ie = trace->DTAMParallel.end(); it != ie;
@@ -185,9 +472,18 @@ void DTAM::dtam() {
 	runtimeData->allDTAMParallelCost.push_back(cost);
 
 	gettimeofday(&start, NULL);
+	gettimeofday(&phase, NULL);
 	DTAMhybrid();
+	runtimeData->DTAMGraphCost += costSince(phase);
 	initTaint(remainPoint);
+	gettimeofday(&phase, NULL);
+	reuseTaint(remainPoint, DTAMCache::Hybrid);
 	propagateTaint(remainPoint);
+	recordTaint(DTAMCache::Hybrid);
+	if (cache) {
+		cache->commit();
+	}
+	runtimeData->DTAMPropagateCost += costSince(phase);
 	getTaint(trace->DTAMhybrid);
 	for (std::set<std::string>::iterator it = trace->DTAMhybrid.begin(), ie = trace->DTAMhybrid.end(); it != ie; it++) {
 		std::string name = (*it);
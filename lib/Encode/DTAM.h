@@ -12,32 +12,55 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
-#include "DTAMPoint.h"
+#include "DTAMCache.h"
 #include "FilterSymbolicExpr.h"
 #include "RuntimeDataManager.h"
 #include "Trace.h"
 
 namespace klee {
 
+/*
+ * every read and write of a global variable is a point, numbered from 0.
+ * the taint flows along the edges from a point to the points it affects,
+ * stored as compressed sparse rows: the edges of point i are
+ * edge[edgeBegin[i]] .. edge[edgeBegin[i + 1] - 1].
+ * the vector clocks of all points are one flat array, each padded with
+ * zeros to clockStride so that they can be compared a whole register at a time.
+ */
 class DTAM {
 	private:
 		RuntimeDataManager* runtimeData;
 		Trace* trace;
-		std::map<std::string, DTAMPoint*> allWrite;
-		std::map<std::string, DTAMPoint*> allRead;
+		std::vector<std::string> pointName;
+		std::vector<DTAMKey> pointKey;
+		std::vector<bool> isWrite;
+		std::vector<char> isTaint;
+		std::vector<unsigned> clocks;
+		unsigned clockStride;
+		std::vector<unsigned> edgeBegin;
+		std::vector<unsigned> edge;
+		DTAMCache* cache; //NULL unless the taint of the last trace is reused
+		std::vector<char> isSeed;
+		std::vector<std::vector<DTAMKey> > incoming;
 		struct timeval start, finish;
 		double cost;
 		FilterSymbolicExpr filter;
 
+		unsigned addPoint(Event *event, bool write);
+		bool happensBefore(unsigned one, unsigned two);
+
 	public:
 		DTAM(RuntimeDataManager* data);
 		virtual ~DTAM();
 
 		void DTAMParallel();
 		void DTAMhybrid();
-		void initTaint(std::vector<DTAMPoint*> &remainPoint);
-		void propagateTaint(std::vector<DTAMPoint*> &remainPoint);
+		void initTaint(std::vector<unsigned> &remainPoint);
+		void reuseTaint(std::vector<unsigned> &remainPoint, DTAMCache::Graph graph);
+		void propagateTaint(std::vector<unsigned> &remainPoint);
+		void recordTaint(DTAMCache::Graph graph);
 		void getTaint(std::set<std::string> &taint);
 		void dtam();
 
@@ -45,4 +68,3 @@ class DTAM {
 
 }
 #endif /* LIB_CORE_DTAM_ */
-
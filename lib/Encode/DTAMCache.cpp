@@ -0,0 +1,38 @@
+//===-- DTAMCache.cpp -----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "DTAMCache.h"
+
+#include <cstddef>
+
+namespace klee {
+
+	DTAMCache::DTAMCache() {
+		reusedPointNum = 0;
+		recomputedPointNum = 0;
+	}
+
+	DTAMCache::Entry* DTAMCache::lookup(const DTAMKey &key) {
+		std::map<DTAMKey, Entry>::iterator it = last.find(key);
+		if (it == last.end()) {
+			return NULL;
+		}
+		return &it->second;
+	}
+
+	DTAMCache::Entry& DTAMCache::record(const DTAMKey &key) {
+		return current[key];
+	}
+
+	void DTAMCache::commit() {
+		last.swap(current);
+		current.clear();
+	}
+
+}
@@ -0,0 +1,80 @@
+//===-- DTAMCache.h ---------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The taint DTAM computed for the last trace, kept for the next one.
+//
+// A point is known by its thread, its position in the thread and its
+// instruction, which stay the same for the prefix a trace shares with
+// the trace before it. The taint of a point only depends on the points
+// that reach it. If a point has the same seed flag and the same incoming
+// edges as in the last trace, and so do all points that reach it, its
+// taint is the one stored here and it does not have to be propagated
+// again.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LIB_ENCODE_DTAMCACHE_H_
+#define LIB_ENCODE_DTAMCACHE_H_
+
+#include <map>
+#include <vector>
+
+namespace klee {
+
+class KInstruction;
+
+struct DTAMKey {
+	unsigned threadId;
+	unsigned threadEventId;
+	KInstruction* inst;
+
+	bool operator<(const DTAMKey &key) const {
+		if (threadId != key.threadId)
+			return threadId < key.threadId;
+		if (threadEventId != key.threadEventId)
+			return threadEventId < key.threadEventId;
+		return inst < key.inst;
+	}
+	bool operator==(const DTAMKey &key) const {
+		return threadId == key.threadId && threadEventId == key.threadEventId && inst == key.inst;
+	}
+};
+
+class DTAMCache {
+public:
+	//DTAMParallel and DTAMhybrid have different edges
+	enum Graph {
+		Parallel, Hybrid, GraphNum
+	};
+
+	struct Entry {
+		bool seed;
+		std::vector<DTAMKey> incoming[GraphNum]; //sorted keys of the sources of the incoming edges
+		bool taint[GraphNum];
+	};
+
+private:
+	std::map<DTAMKey, Entry> last; //points of the last trace
+	std::map<DTAMKey, Entry> current; //points of the trace being analysed
+
+public:
+	unsigned reusedPointNum;
+	unsigned recomputedPointNum;
+
+	DTAMCache();
+	//NULL if the last trace had no such point
+	Entry* lookup(const DTAMKey &key);
+	Entry& record(const DTAMKey &key);
+	//the current trace becomes the last one
+	void commit();
+};
+
+}
+
+#endif /* LIB_ENCODE_DTAMCACHE_H_ */
@@ -20,9 +20,13 @@
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
 #include <llvm/Support/Casting.h>
+#include <llvm/Support/CommandLine.h>
 #include <llvm/Support/raw_ostream.h>
+#include <pthread.h>
 #include <sys/time.h>
+#include <algorithm>
 #include <cctype>
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -35,9 +39,12 @@
 #include <string>
 #include <vector>
 
+#include "../../include/klee/Common.h"
+#include "../../include/klee/Constraints.h"
 #include "../../include/klee/Expr.h"
 #include "../../include/klee/Internal/Module/InstructionInfoTable.h"
 #include "../../include/klee/Internal/Module/KInstruction.h"
+#include "../../include/klee/Internal/Support/ErrorHandling.h"
 #include "../../include/klee/util/Ref.h"
 #include "Prefix.h"
 
@@ -54,25 +61,152 @@
 using namespace llvm;
 using namespace std;
 using namespace z3;
+
+namespace {
+	cl::opt<klee::SolverStrategy> EncodeSolverStrategy("encode-solver-strategy",
+			cl::desc("Logic and tactics used by the solvers of Encode (default=auto)"),
+			cl::values(clEnumValN(klee::AutoStrategy, "auto", "QF_IDL for order-only traces, otherwise the bv pipeline if no incremental solver is needed"),
+					clEnumValN(klee::DefaultStrategy, "default", "z3 general purpose solver"),
+					clEnumValN(klee::IDLStrategy, "idl", "QF_IDL solver"),
+					clEnumValN(klee::LIAStrategy, "lia", "QF_LIA solver"),
+					clEnumValN(klee::BVStrategy, "bv", "simplify/solve-eqs/smt tactic pipeline for bit-vector data"),
+					clEnumValEnd), cl::init(klee::AutoStrategy));
+
+	cl::opt<bool> EncodeBenchmarkStrategies("encode-benchmark-strategies", cl::init(false),
+			cl::desc("Solve every branch query with all solver strategies and log the cost to ./output_info/strategy.txt (default=off)"));
+
+	cl::opt<unsigned> EncodeLockChainThreshold("encode-lock-chain-threshold", cl::init(64),
+			cl::desc("Encode mutexes with more critical sections than this as one chain of acquisitions instead of pairwise, 0 means always pairwise (default=64)"));
+
+	cl::opt<bool> EncodeUnsatCorePruning("encode-unsat-core-pruning", cl::init(true),
+			cl::desc("Decide a branch query as unsat without solving if it contains the unsat core of a former one (default=on)"));
+
+	cl::opt<bool> EncodeBranchCone("encode-branch-cone", cl::init(false),
+			cl::desc("Solve each branch query against a formula sliced to the variables the branch depends on (default=off)"));
+
+	cl::opt<unsigned> EncodeQueryTimeout("encode-query-timeout", cl::init(10000),
+			cl::desc("Time limit of each branch query in ms, 0 means unlimited (default=10000)"));
+
+	cl::opt<unsigned> EncodeQueryRlimit("encode-query-rlimit", cl::init(0),
+			cl::desc("z3 resource limit of each query, 0 means unlimited (default=0)"));
+
+	cl::opt<double> EncodeTraceBudget("encode-trace-budget", cl::init(0),
+			cl::desc("Seconds of solving spent on one trace before the rest of its queries give up, 0 means unlimited (default=0)"));
+
+	cl::opt<unsigned> EncodeRetryRounds("encode-retry-rounds", cl::init(2),
+			cl::desc("Times a timed out branch query is retried after the other queries of the trace (default=2)"));
+
+	cl::opt<unsigned> EncodeRetryFactor("encode-retry-factor", cl::init(4),
+			cl::desc("Each retry multiplies the time limit of the query by this factor (default=4)"));
+
+	cl::opt<std::string> EncodeDumpQueries("encode-dump-queries", cl::init(""),
+			cl::desc("Write every branch and assert query of Encode as SMT-LIB2 into this directory, see encode-bench (default=off)"));
+
+	cl::opt<unsigned> EncodePTSThreads("encode-pts-threads", cl::init(1),
+			cl::desc("Threads that check the taint candidates of PTS, each with its own z3 context (default=1)"));
+
+	cl::opt<bool> EncodeKleeSolver("encode-klee-solver", cl::init(false),
+			cl::desc("Solve the queries of Encode with the solver chain of klee (-solver-backend, caches, independence), z3 solves the queries it can not express (default=off)"));
+
+	cl::opt<bool> EncodeIncremental("encode-incremental", cl::init(false),
+			cl::desc("Encode all traces in one solver and reuse the formulas a trace shares with its parent (default=off)"));
+
+	cl::opt<unsigned> EncodeIncrementalMax("encode-incremental-max", cl::init(1000000),
+			cl::desc("Restart the shared solver of -encode-incremental after this many formulas, 0 means unlimited (default=1000000)"));
+}
+
 namespace klee {
 
+	static EncodeCache* getEncodeCache(RuntimeDataManager* data) {
+		if (EncodeIncremental && !data->encodeCache) {
+			data->encodeCache = new EncodeCache(EncodeIncrementalMax);
+		}
+		return data->encodeCache;
+	}
+
+	static Solver* getEncodeSolver(RuntimeDataManager* data) {
+		if (EncodeKleeSolver && !data->encodeSolver) {
+			data->encodeSolver = constructSolverChain(createCoreSolver(CoreSolverToUse),
+					"./output_info/encode-all-queries.smt2", "./output_info/encode-solver-queries.smt2",
+					"./output_info/encode-all-queries.pc", "./output_info/encode-solver-queries.pc");
+		}
+		return data->encodeSolver;
+	}
+
+	Encode::Encode(RuntimeDataManager* data) :
+			runtimeData(data), cache(getEncodeCache(data)), ownContext(cache ? NULL : new context()),
+					z3_ctx(cache ? cache->getContext() : *ownContext), z3_solver(z3_ctx),
+					z3_taint_solver(z3_ctx), kq(z3_ctx), baseAssumptions(z3_ctx), queryAssumptions(z3_ctx),
+					kleeSolver(getEncodeSolver(data)), toKQuery(z3_ctx), kleeModel(z3_ctx, Z3_mk_model(z3_ctx)) {
+		trace = data->getCurrentTrace();
+		formulaNum = 0;
+		strategy = DefaultStrategy;
+		solvingTimes = 0;
+		budgetCost = 0;
+		retrying = false;
+		baseAssertionNum = 0;
+		solvedByKlee = false;
+	}
+
 	struct Pair {
 			int order; //the order of a event
 			Event *event;
 	};
 
+	static bool lessOrder(const Pair &one, const Pair &two) {
+		return one.order < two.order;
+	}
+
+	//read the value of an order variable from the model without printing it
+	static int evalOrder(context &z3_ctx, model &m, const expr &order) {
+		expr value = m.eval(order, true);
+		int ret = 0;
+		if (!Z3_get_numeral_int(z3_ctx, value, &ret)) {
+			assert(0 && "order of event is not a numeral");
+		}
+		return ret;
+	}
+
+	//the write PSOListener puts behind the read of an atomic read-modify-write,
+	//the only virtual event that belongs to its predecessor
+	static bool isAtomicWrite(Event* event) {
+		Instruction *I = event->inst->inst;
+		return event->eventType == Event::VIRTUAL && (isa<AtomicRMWInst>(I) || isa<AtomicCmpXchgInst>(I));
+	}
+
 	void Encode::buildAllFormula() {
-		buildInitValueFormula(z3_solver);
-		buildPathCondition(z3_solver);
+		//the memory model merges the event names the other formulas use
 		buildMemoryModelFormula(z3_solver);
 		buildPartialOrderFormula(z3_solver);
-		buildReadWriteFormula(z3_solver);
 		buildSynchronizeFormula(z3_solver);
+		vector<pair<string, expr> > *sliced = NULL;
+		if (EncodeBranchCone) {
+			//every cone reuses them, see buildConeSolver
+			expr_vector assertions = z3_solver.assertions();
+			for (unsigned k = 0; k < assertions.size(); k++) {
+				orderFormula.push_back(assertions[k]);
+			}
+			sliced = &dataFormula;
+		}
+		buildInitValueFormula(z3_solver, sliced);
+		buildPathCondition(z3_solver, sliced);
+		markLatestWriteForGlobalVar();
+		buildReadWriteFormula(z3_solver, sliced);
+
+		if (cache) {
+			//only the formulas not seen in former traces reach the shared solver,
+			//all later queries of this trace push on top of it
+			if (cache->getStrategy() != strategy || cache->isFull(z3_solver.assertions().size())) {
+				cache->restart(makeSolver(strategy), strategy);
+			}
+			cache->track(z3_solver, baseAssumptions);
+			z3_solver = cache->getSolver();
+		}
 
 		check_result result;
 		try {
 			//statics
-			result = z3_solver.check();
+			result = checkBase();
 			if (result == z3::sat) {
 				std::cerr << "buildAllFormula  success!" << "\n";
 			} else {
@@ -87,6 +221,7 @@ namespace klee {
 
 		buildInitValueFormula(z3_taint_solver);
 		buildPathCondition(z3_taint_solver);
+		markLatestWriteForGlobalVar();
 		buildReadWriteFormula(z3_taint_solver);
 
 		buildMemoryModelFormula(z3_taint_solver);
@@ -125,135 +260,219 @@ namespace klee {
 		}
 		out_file.close();
 #endif
+		/*
+		 * one incremental pass over all asserts. _V is the order of the violating
+		 * assert, every assert and branch ordered before it has to hold, and a_i
+		 * selects assert i as the violated one. each model gives one violated
+		 * assert, which is blocked before solving again.
+		 */
+		markQueryStart();
 		z3_solver.push();	//backtrack 1
 		std::cerr << "\nThe number of assert: " << assertFormula.size() << "\n";
+		expr violation = z3_ctx.int_const("_V");
+		vector<unsigned> candidate;
+		vector<expr> selector;
 		for (unsigned i = 0; i < assertFormula.size(); i++) {
+			Event* curr = assertFormula[i].first;
+			//the same assert has been violated in a former trace
+			if (runtimeData->isAssertViolated(curr->inst->info->file, curr->inst->info->line)) {
+				continue;
+			}
+			stringstream ss;
+			ss << "_A" << i;
+			expr select = z3_ctx.bool_const(ss.str().c_str());
+			expr currOrder = z3_ctx.int_const(curr->eventName.c_str());
+			z3_solver.add(implies(select, violation == currOrder && !assertFormula[i].second));
+			candidate.push_back(i);
+			selector.push_back(select);
+		}
+		for (unsigned j = 0; j < assertFormula.size(); j++) {
+			addBeforeViolation(assertFormula[j].first, assertFormula[j].second, violation, candidate, selector);
+		}
+		for (unsigned j = 0; j < ifFormula.size(); j++) {
+			addBeforeViolation(ifFormula[j].first, ifFormula[j].second, violation, candidate, selector);
+		}
+		//statics
+		formulaNum += assertFormula.size() + ifFormula.size();
+
+		bool violated = false;
+		while (!candidate.empty()) {
+			z3_solver.push();	//backtrack point 2
+			z3_solver.add(makeExprsOr(selector));
 #if BRANCH_INFO
 			stringstream ss;
-			ss << "Trace" << trace->Id << "#"
-//				<< assertFormula[i].first->inst->info->file << "#"
-					<< assertFormula[i].first->inst->info->line << "#" << assertFormula[i].first->eventName << "#"
-					<< assertFormula[i].first->brCondition << "-" << !(assertFormula[i].first->brCondition) << "assert_bug";
-			std::cerr << "Verifying assert " << i + 1 << " @" << ss.str() << ": ";
+			ss << "Trace" << trace->Id << "#assert_bug";
+			std::cerr << "Verifying " << candidate.size() << " asserts @" << ss.str() << ": ";
+			dumpQuery(ss.str(), assertFormula[candidate[0]].first);
+#endif
+			check_result result = solveQuery(EncodeQueryTimeout);
+			solvingTimes++;
+			if (result != z3::sat) {
+				if (result == z3::unknown) {
+					std::cerr << "unknown!\n";
+				} else {
+#if BRANCH_INFO
+					std::cerr << "No!\n";
 #endif
-			z3_solver.push();	//backtrack point 2
-//		buildAllFormula();
-
-			Event* curr = assertFormula[i].first;
-
-			z3_solver.add(!assertFormula[i].second);
-			for (unsigned j = 0; j < assertFormula.size(); j++) {
-				if (j == i) {
-					continue;
 				}
-				Event* temp = assertFormula[j].first;
-				expr currIf = z3_ctx.int_const(curr->eventName.c_str());
-				expr tempIf = z3_ctx.int_const(temp->eventName.c_str());
-				expr constraint = z3_ctx.bool_val(1);
-				if (curr->threadId == temp->threadId) {
-					if (curr->eventId > temp->eventId)
-						constraint = assertFormula[j].second;
-				} else
-					constraint = implies(tempIf < currIf, assertFormula[j].second);
-				z3_solver.add(constraint);
+				z3_solver.pop();	//backtrack point 2
+				break;
 			}
-			for (unsigned j = 0; j < ifFormula.size(); j++) {
-				Event* temp = ifFormula[j].first;
-				expr currIf = z3_ctx.int_const(curr->eventName.c_str());
-				expr tempIf = z3_ctx.int_const(temp->eventName.c_str());
-				expr constraint = z3_ctx.bool_val(1);
-				if (curr->threadId == temp->threadId) {
-					if (curr->eventId > temp->eventId)
-						constraint = ifFormula[j].second;
-				} else
-					constraint = implies(tempIf < currIf, ifFormula[j].second);
-				z3_solver.add(constraint);
+			std::cerr << "Yes!\n";
+			model m = getModel();
+			unsigned k = 0;
+			while (k < selector.size() && !eq(m.eval(selector[k], true), z3_ctx.bool_val(true))) {
+				k++;
 			}
-			formulaNum = formulaNum + ifFormula.size() - 1;
-			//statics
-
-			check_result result = z3_solver.check();
-
-			solvingTimes++;
-			stringstream output;
-			if (result == z3::sat) {
-				//should compute the prefix violating assert
-				std::cerr << "Yes!\n";
+			assert(k < selector.size() && "no assert is selected by the model");
+			unsigned i = candidate[k];
+			Event* curr = assertFormula[i].first;
+			stringstream name;
+			name << "Trace" << trace->Id << "#" << curr->inst->info->line << "#" << curr->eventName << "#" << curr->brCondition
+					<< "-" << !(curr->brCondition) << "assert_bug";
+			//replay the witnesses of this trace only
+			if (!violated) {
 				runtimeData->clearAllPrefix();
-
-				//former :: replay the bug trace and erminate klee. later:: terminate klee directly
-				if (true) {
-					vector<Event*> vecEvent;
-					computePrefix(vecEvent, assertFormula[i].first);
-					Prefix* prefix = new Prefix(vecEvent, trace->createThreadPoint, ss.str());
-					output << "./output_info/" << prefix->getName() << ".z3expr";
-					runtimeData->addScheduleSet(prefix);
-//			} else {
-					std::cerr << "Assert Failure at " << assertFormula[i].first->inst->info->file << ": "
-							<< assertFormula[i].first->inst->info->line << "\n";
+				violated = true;
+			}
+			vector<Event*> vecEvent;
+			computePrefix(vecEvent, curr);
+			Prefix* prefix = new Prefix(vecEvent, trace->createThreadPoint, name.str());
+			runtimeData->addScheduleSet(prefix);
+			runtimeData->addViolatedAssert(curr->inst->info->file, curr->inst->info->line);
+			std::cerr << "Assert Failure at " << curr->inst->info->file << ": " << curr->inst->info->line << "\n";
 #if FORMULA_DEBUG
-					showPrefixInfo(prefix, assertFormula[i].first);
+			showPrefixInfo(prefix, curr);
+			stringstream output;
+			output << "./output_info/" << prefix->getName() << ".z3expr";
+			std::ofstream out_file(output.str().c_str(), std::ios_base::out | std::ios_base::app);
+			out_file << "!assertFormula[i].second : " << !assertFormula[i].second << "\n";
+			out_file << "\n" << z3_solver << "\n";
+			out_file << "\nz3_solver.get_model()\n";
+			out_file << "\n" << m << "\n";
+			out_file.close();
 #endif
-
+			z3_solver.pop();	//backtrack point 2
+			//block the violated assert and the other asserts on the same line
+			for (unsigned c = 0; c < candidate.size();) {
+				Event* other = assertFormula[candidate[c]].first;
+				if (other->inst->info->line == curr->inst->info->line && other->inst->info->file == curr->inst->info->file) {
+					candidate.erase(candidate.begin() + c);
+					selector.erase(selector.begin() + c);
+				} else {
+					c++;
 				}
-#if FORMULA_DEBUG
-				std::ofstream out_file(output.str().c_str(), std::ios_base::out | std::ios_base::app);
-				out_file << "!assertFormula[i].second : " << !assertFormula[i].second << "\n";
-				out_file << "\n" << z3_solver << "\n";
-				model m = z3_solver.get_model();
-				out_file << "\nz3_solver.get_model()\n";
-				out_file << "\n" << m << "\n";
-				out_file.close();
-#endif
-//		logStatisticInfo();
-				return false;
-			} else if (result == z3::unknown) {
-				std::cerr << "assert" << i << ": unknown!\n";
-			} else if (result == z3::unsat) {
-#if BRANCH_INFO
-				std::cerr << "No!\n";
-#endif
 			}
-			z3_solver.pop();	//backtrack point 2
 		}
 		z3_solver.pop();	//backtrack 1
 		std::cerr << "\nVerifying is over!\n";
-		return true;
+		return !violated;
+	}
+
+	/*
+	 * the condition of event has to hold if it happens before the violated assert.
+	 * events of one thread clustered by controlGranularity share their order variable
+	 * with the assert, for them the position in the thread decides.
+	 */
+	void Encode::addBeforeViolation(Event* event, expr condition, expr violation, vector<unsigned> &candidate,
+			vector<expr> &selector) {
+		expr order = z3_ctx.int_const(event->eventName.c_str());
+		z3_solver.add(implies(order < violation, condition));
+		for (unsigned k = 0; k < candidate.size(); k++) {
+			Event* curr = assertFormula[candidate[k]].first;
+			if (curr->threadId == event->threadId && curr->eventName == event->eventName && event->eventId < curr->eventId) {
+				z3_solver.add(implies(selector[k], condition));
+			}
+		}
 	}
 
 	void Encode::check_if() {
 		unsigned sum = 0, num = 0;
 		unsigned size = ifFormula.size();
 		std::cerr << "Sum of branches: " << size << "\n";
+		//queries that ran out of their budget, retried with more time once the cheap ones are done
+		vector<unsigned> retryQueue;
 		for (unsigned i = 0; i < ifFormula.size(); i++) {
 			num++;
+			check_result result = checkBranch(i, num, EncodeQueryTimeout);
+			if (result == z3::sat) {
+				sum++;
+			} else if (result == z3::unknown) {
+				retryQueue.push_back(i);
+			}
+		}
+
+		//a query is counted in timeoutQuery when it first runs out, the retries only in retryQuery
+		retrying = true;
+		unsigned timeout = EncodeQueryTimeout;
+		for (unsigned round = 0; round < EncodeRetryRounds && !retryQueue.empty() && timeout; round++) {
+			timeout *= EncodeRetryFactor;
+			vector<unsigned> unknownQueue;
+			for (unsigned k = 0; k < retryQueue.size(); k++) {
+				runtimeData->retryQuery++;
+				check_result result = checkBranch(retryQueue[k], retryQueue[k] + 1, timeout);
+				if (result == z3::sat) {
+					sum++;
+				} else if (result == z3::unknown) {
+					unknownQueue.push_back(retryQueue[k]);
+				}
+			}
+			retryQueue.swap(unknownQueue);
+		}
+		retrying = false;
+		runtimeData->unknownBranch += retryQueue.size();
+
+//	//print log
+//	logStatisticInfo();
+//
+//	if (sum == 0)
+//		std::cerr << "\nAll the branches can't be negated!\n";
+//	else
+//		std::cerr << "\nIn total, there are " << sum << "/" << size
+//				<< " branches can be negated!\n";
+	}
+
+	//negate the i-th branch, num is only used for the log
+	check_result Encode::checkBranch(unsigned i, unsigned num, unsigned timeout) {
+		check_result result = z3::unsat;
+		//the query runs against the whole trace or only against the cone of branch i
+		solver traceSolver = z3_solver;
+		expr_vector traceAssumptions = baseAssumptions;
+		vector<bool> coneBranch(ifFormula.size(), true);
+		if (EncodeBranchCone) {
+			std::set<std::string> cone;
+			computeBranchCone(i, cone, coneBranch);
+			z3_solver = buildConeSolver(cone);
+			baseAssumptions = expr_vector(z3_ctx);
+		}
 #if BRANCH_INFO
 //		std::cerr << ifFormula[i].second << "\n";
-			stringstream ss;
-			ss << "Trace" << trace->Id << "#"
+		stringstream ss;
+		ss << "Trace" << trace->Id << "#"
 //				<< ifFormula[i].first->inst->info->file << "#"
-					<< ifFormula[i].first->inst->info->line << "#" << ifFormula[i].first->eventName << "#"
-					<< ifFormula[i].first->brCondition << "-" << !(ifFormula[i].first->brCondition);
-			std::cerr << "Verifying branch " << num << " @" << ss.str() << ": ";
+				<< ifFormula[i].first->inst->info->line << "#" << ifFormula[i].first->eventName << "#"
+				<< ifFormula[i].first->brCondition << "-" << !(ifFormula[i].first->brCondition);
+		std::cerr << "Verifying branch " << num << " @" << ss.str() << ": ";
 #endif
 
-			//create a backstracking point
-			z3_solver.push();
+		//create a backstracking point
+		markQueryStart();
+		z3_solver.push();
 
-			struct timeval start, finish;
-			gettimeofday(&start, NULL);
+		struct timeval start, finish;
+		gettimeofday(&start, NULL);
 #if !OPTIMIZATION2
-			bool branch = filter.filterUselessWithSet(trace, trace->brRelatedSymbolicExpr[i]);
+		bool branch = filter.filterUselessWithSet(trace, trace->brRelatedSymbolicExpr[i]);
 #else
-			bool branch = true;
+		bool branch = true;
 #endif
-			gettimeofday(&finish, NULL);
+		gettimeofday(&finish, NULL);
 //			double cost = (double) (finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
 //			std::cerr << "CCost : " << cost << "    ";
 
-			if (!branch) {
+		if (!branch) {
 #if BRANCH_INFO
-				std::cerr << "NNo!\n";
+			std::cerr << "NNo!\n";
 #endif
 //		} else {
 //			std::cerr << "YYes!\n";
@@ -291,125 +510,170 @@ namespace klee {
 //			double cost = (double) (finish.tv_sec * 1000000UL + finish.tv_usec
 //					- start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
 //			std::cerr << "CCCost : " << cost << "\n";
-			}
+		}
 
-			if (branch) {
+		if (branch) {
 //			buildAllFormula();
 
-				Event* curr = ifFormula[i].first;
+			Event* curr = ifFormula[i].first;
 
 #if !OPTIMIZATION3
-			//添加读写的解
-			std::set<std::string> &RelatedSymbolicExpr = trace->RelatedSymbolicExpr;
-			std::vector<ref<klee::Expr> > &rwSymbolicExpr = trace->rwSymbolicExpr;
-			std::string varName;
-			unsigned int totalRwExpr = rwFormula.size();
-			for (unsigned int j = 0; j < totalRwExpr; j++){
-				varName = filter.getName(rwSymbolicExpr[j]->getKid(1));
-				if (RelatedSymbolicExpr.find(varName) == RelatedSymbolicExpr.end()){
-					Event* temp = rwFormula[j].first;
-					expr currIf = z3_ctx.int_const(curr->eventName.c_str());
-					expr tempIf = z3_ctx.int_const(temp->eventName.c_str());
-					expr constraint = z3_ctx.bool_val(1);
-					if (curr->threadId == temp->threadId) {
-						if (curr->eventId > temp->eventId)
-							constraint = rwFormula[j].second;
-					} else {
-						constraint = implies(tempIf < currIf, rwFormula[j].second);
-					}
-					z3_solver.add(constraint);
-//					z3_solver.add(rwFormula[j].second);
+		//添加读写的解
+		std::set<std::string> &RelatedSymbolicExpr = trace->RelatedSymbolicExpr;
+		std::vector<ref<klee::Expr> > &rwSymbolicExpr = trace->rwSymbolicExpr;
+		std::string varName;
+		unsigned int totalRwExpr = rwFormula.size();
+		for (unsigned int j = 0; j < totalRwExpr; j++){
+			varName = filter.getName(rwSymbolicExpr[j]->getKid(1));
+			if (RelatedSymbolicExpr.find(varName) == RelatedSymbolicExpr.end()){
+				Event* temp = rwFormula[j].first;
+				expr currIf = z3_ctx.int_const(curr->eventName.c_str());
+				expr tempIf = z3_ctx.int_const(temp->eventName.c_str());
+				expr constraint = z3_ctx.bool_val(1);
+				if (curr->threadId == temp->threadId) {
+					if (curr->eventId > temp->eventId)
+						constraint = rwFormula[j].second;
+				} else {
+					constraint = implies(tempIf < currIf, rwFormula[j].second);
 				}
+				addQueryConstraint(constraint);
+//					z3_solver.add(rwFormula[j].second);
 			}
+		}
 #endif
 
-				z3_solver.add(!ifFormula[i].second);
-				for (unsigned j = 0; j < ifFormula.size(); j++) {
-					if (j == i) {
-						continue;
-					}
-					Event* temp = ifFormula[j].first;
-					expr currIf = z3_ctx.int_const(curr->eventName.c_str());
-					expr tempIf = z3_ctx.int_const(temp->eventName.c_str());
-					expr constraint = z3_ctx.bool_val(1);
-					if (curr->threadId == temp->threadId) {
-						if (curr->eventId > temp->eventId)
-							constraint = ifFormula[j].second;
-					} else
-						constraint = implies(tempIf < currIf, ifFormula[j].second);
-					z3_solver.add(constraint);
-				}
-				//statics
-				formulaNum = formulaNum + ifFormula.size() - 1;
-				//solving
-				check_result result;
-				struct timeval start, finish;
-
-				gettimeofday(&start, NULL);
-				try {
-					//statics
-					result = z3_solver.check();
-				} catch (z3::exception & ex) {
-					std::cerr << "\nUnexpected error: " << ex.msg() << "\n";
+			addQueryConstraint(!ifFormula[i].second);
+			for (unsigned j = 0; j < ifFormula.size(); j++) {
+				if (j == i || !coneBranch[j]) {
 					continue;
 				}
-				gettimeofday(&finish, NULL);
-				double cost = (double) (finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
+				Event* temp = ifFormula[j].first;
+				expr currIf = z3_ctx.int_const(curr->eventName.c_str());
+				expr tempIf = z3_ctx.int_const(temp->eventName.c_str());
+				expr constraint = z3_ctx.bool_val(1);
+				if (curr->threadId == temp->threadId) {
+					if (curr->eventId > temp->eventId)
+						constraint = ifFormula[j].second;
+				} else
+					constraint = implies(tempIf < currIf, ifFormula[j].second);
+				addQueryConstraint(constraint);
+			}
+			//statics
+			formulaNum = formulaNum + ifFormula.size() - 1;
+			if (EncodeBenchmarkStrategies) {
+				benchmarkStrategies(ss.str());
+			}
+			dumpQuery(ss.str(), curr);
+			if (implyKnownCore()) {
+				//an unsat core of a former query is part of this one
 #if BRANCH_INFO
-				std::cerr << "Cost : " << cost << " ";
+				std::cerr << "No! (core)\n";
 #endif
-				solvingTimes++;
-				stringstream output;
-				if (result == z3::sat) {
-					vector<Event*> vecEvent;
-					computePrefix(vecEvent, ifFormula[i].first);
-					Prefix* prefix = new Prefix(vecEvent, trace->createThreadPoint, ss.str());
-					output << "./output_info/" << prefix->getName() << ".z3expr";
-					//printf prefix to DIR output_info
-					runtimeData->addScheduleSet(prefix);
-					runtimeData->satBranch++;
-					runtimeData->satCost += cost;
-					sum++;
+				runtimeData->unSatBranchByPreSolve++;
+				clearQueryConstraints();
+				z3_solver.pop();
+				z3_solver = traceSolver;
+				baseAssumptions = traceAssumptions;
+				return z3::unsat;
+			}
+			//solving
+			struct timeval start, finish;
+
+			gettimeofday(&start, NULL);
+			result = solveQuery(timeout);
+			gettimeofday(&finish, NULL);
+			double cost = (double) (finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
+#if BRANCH_INFO
+			std::cerr << "Cost : " << cost << " ";
+#endif
+			solvingTimes++;
+			stringstream output;
+			if (result == z3::sat) {
+				vector<Event*> vecEvent;
+				computePrefix(vecEvent, ifFormula[i].first);
+				Prefix* prefix = new Prefix(vecEvent, trace->createThreadPoint, ss.str());
+				output << "./output_info/" << prefix->getName() << ".z3expr";
+				//printf prefix to DIR output_info
+				runtimeData->addScheduleSet(prefix);
+				runtimeData->satBranch++;
+				runtimeData->satCost += cost;
 #if FORMULA_DEBUG
-					showPrefixInfo(prefix, ifFormula[i].first);
-					std::ofstream out_file(output.str().c_str(), std::ios_base::out | std::ios_base::app);
-					out_file << "!ifFormula[i].second : " << !ifFormula[i].second << "\n";
-					out_file << "\n" << z3_solver << "\n";
-					model m = z3_solver.get_model();
-					out_file << "\nz3_solver.get_model()\n";
-					out_file << "\n" << m << "\n";
-					out_file.close();
+				showPrefixInfo(prefix, ifFormula[i].first);
+				std::ofstream out_file(output.str().c_str(), std::ios_base::out | std::ios_base::app);
+				out_file << "!ifFormula[i].second : " << !ifFormula[i].second << "\n";
+				out_file << "\n" << z3_solver << "\n";
+				model m = getModel();
+				out_file << "\nz3_solver.get_model()\n";
+				out_file << "\n" << m << "\n";
+				out_file.close();
 #endif
-				} else {
-					runtimeData->unSatBranchBySolve++;
-					runtimeData->unSatCost += cost;
-				}
+			} else if (result == z3::unsat) {
+				runtimeData->unSatBranchBySolve++;
+				runtimeData->unSatCost += cost;
+				recordUnsatCore();
+			}
 
 #if BRANCH_INFO
-				if (result == z3::sat) {
-					std::cerr << "Yes!\n";
-				} else if (result == z3::unsat) {
-					std::cerr << "No!\n";
-				} else
-					std::cerr << "Warning!\n";
+			if (result == z3::sat) {
+				std::cerr << "Yes!\n";
+			} else if (result == z3::unsat) {
+				std::cerr << "No!\n";
+			} else
+				std::cerr << "Warning!\n";
 #endif
 
-			} else {
-				runtimeData->unSatBranchByPreSolve++;
-			}
-			//backstracking
-			z3_solver.pop();
+		} else {
+			runtimeData->unSatBranchByPreSolve++;
+		}
+		clearQueryConstraints();
+		//backstracking
+		z3_solver.pop();
+		z3_solver = traceSolver;
+		baseAssumptions = traceAssumptions;
+		return result;
+	}
 
+	//the variables of branch i and of the other branches that share variables with it
+	void Encode::computeBranchCone(unsigned i, std::set<std::string> &cone, vector<bool> &coneBranch) {
+		std::vector<std::set<std::string>*> &brRelatedSymbolicExpr = trace->brRelatedSymbolicExpr;
+		FilterSymbolicExpr::getConeOfInfluence(trace, brRelatedSymbolicExpr[ifBrIndex[i]], cone);
+		coneBranch.assign(ifFormula.size(), false);
+		coneBranch[i] = true;
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (unsigned j = 0; j < ifFormula.size(); j++) {
+				if (coneBranch[j] || !FilterSymbolicExpr::isIntersect(brRelatedSymbolicExpr[ifBrIndex[j]], &cone)) {
+					continue;
+				}
+				coneBranch[j] = true;
+				FilterSymbolicExpr::getConeOfInfluence(trace, brRelatedSymbolicExpr[ifBrIndex[j]], cone);
+				changed = true;
+			}
 		}
+	}
 
-//	//print log
-//	logStatisticInfo();
-//
-//	if (sum == 0)
-//		std::cerr << "\nAll the branches can't be negated!\n";
-//	else
-//		std::cerr << "\nIn total, there are " << sum << "/" << size
-//				<< " branches can be negated!\n";
+	/*
+	 * the formula of the trace sliced to the variables of cone. the order and
+	 * sync formulas are kept whole, the data formulas only for these variables.
+	 * both were built once by buildAllFormula.
+	 */
+	solver Encode::buildConeSolver(std::set<std::string> &cone) {
+		solver coneSolver = makeSolver(strategy);
+		for (unsigned k = 0; k < orderFormula.size(); k++) {
+			coneSolver.add(orderFormula[k]);
+		}
+		for (unsigned k = 0; k < dataFormula.size(); k++) {
+			if (cone.find(dataFormula[k].first) != cone.end()) {
+				coneSolver.add(dataFormula[k].second);
+			}
+		}
+		for (unsigned k = 0; k < implicitBrFormula.size(); k++) {
+			if (FilterSymbolicExpr::isIntersect(trace->brRelatedSymbolicExpr[implicitBrFormula[k].first], &cone)) {
+				coneSolver.add(implicitBrFormula[k].second);
+			}
+		}
+		return coneSolver;
 	}
 
 	void Encode::showInitTrace() {
@@ -441,12 +705,120 @@ namespace klee {
 		printSourceLine("./output_info/source_trace", trace->path);
 	}
 
+	enum PTSState {
+		PTSUndecided, PTSRunning, PTSTaint, PTSNoTaint
+	};
+
+	//the candidates of PTS, shared by all workers
+	struct PTSWork {
+		vector<int> state;
+		unsigned next;
+		//seconds of the trace budget left when PTS started, if there is one
+		bool limited;
+		double left;
+		//seconds spent by all workers, counted against left
+		double cost;
+		unsigned timeoutQuery;
+		unsigned unknownQuery;
+		pthread_mutex_t lock;
+	};
+
+	//a worker solves in its own context, z3 contexts can not be shared between threads
+	struct PTSWorker {
+		solver z3_solver;
+		vector<expr> queries;
+		PTSWork *work;
+		PTSWorker(solver &_solver, PTSWork *_work) :
+				z3_solver(_solver), work(_work) {
+		}
+	};
+
+	static void *checkPTS(void *arg) {
+		PTSWorker *worker = (PTSWorker *) arg;
+		PTSWork *work = worker->work;
+		for (;;) {
+			pthread_mutex_lock(&work->lock);
+			while (work->next < work->state.size() && work->state[work->next] != PTSUndecided) {
+				work->next++;
+			}
+			unsigned i = work->next;
+			if (i < work->state.size()) {
+				work->state[i] = PTSRunning;
+			}
+			//the same limits as solveQuery
+			unsigned timeout = EncodeQueryTimeout;
+			bool exhausted = false;
+			if (work->limited) {
+				double left = work->left - work->cost;
+				if (left <= 0) {
+					exhausted = true;
+				} else {
+					unsigned leftMs = (unsigned) (left * 1000) + 1;
+					if (!timeout || leftMs < timeout) {
+						timeout = leftMs;
+					}
+				}
+			}
+			pthread_mutex_unlock(&work->lock);
+			if (i >= work->state.size()) {
+				break;
+			}
+
+			//each candidate is decided by its own query: a model of it only satisfies the
+			//branches before this candidate, so it says nothing about the others
+			check_result result = z3::unknown;
+			bool timedOut = exhausted;
+			struct timeval start, finish;
+			gettimeofday(&start, NULL);
+			if (!exhausted) {
+				params p(worker->z3_solver.ctx());
+				//0 leaves z3 without limit
+				p.set("timeout", timeout ? timeout : UINT_MAX);
+				if (EncodeQueryRlimit) {
+					p.set("rlimit", (unsigned) EncodeQueryRlimit);
+				}
+				worker->z3_solver.push();
+				worker->z3_solver.add(worker->queries[i]);
+				try {
+					worker->z3_solver.set(p);
+					result = worker->z3_solver.check();
+					if (result == z3::unknown) {
+						string reason = worker->z3_solver.reason_unknown();
+						timedOut = reason.find("timeout") != string::npos || reason.find("canceled") != string::npos
+								|| reason.find("resource") != string::npos;
+					}
+				} catch (z3::exception & ex) {
+					std::cerr << "\nUnexpected error: " << ex.msg() << "\n";
+					result = z3::unknown;
+				}
+				worker->z3_solver.pop();
+			}
+			gettimeofday(&finish, NULL);
+
+			pthread_mutex_lock(&work->lock);
+			work->cost += (double) (finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
+			if (result == z3::unknown) {
+				if (timedOut) {
+					work->timeoutQuery++;
+				} else {
+					work->unknownQuery++;
+				}
+			}
+			//an unknown candidate stays potentially tainted
+			work->state[i] = result == z3::unsat ? PTSNoTaint : PTSTaint;
+			pthread_mutex_unlock(&work->lock);
+		}
+		return NULL;
+	}
+
 	void Encode::PTS() {
 
 //	Trace *trace = runtimeData->getCurrentTrace();
 
 //	filter.filterUselessByTaint(trace);
 
+		struct timeval start, finish;
+		gettimeofday(&start, NULL);
 		buildPTSFormula();
 
 //	std::cerr << "z3_taint_solver \n" << z3_taint_solver;
@@ -464,83 +836,100 @@ namespace klee {
 			}
 		}
 
-		for (std::vector<std::string>::iterator it = PTS.begin(); it != PTS.end();) {
-
-			z3_taint_solver.push();
-
+		//a candidate is tainted if its tag can be true with the branches before it
+		vector<expr> queries;
+		for (std::vector<std::string>::iterator it = PTS.begin(), ie = PTS.end(); it != ie; it++) {
 			std::string varName = (*it) + "_tag";
-//		std::cerr << "varName : " << varName << "\n";
-			expr lhs = z3_ctx.bool_const(varName.c_str());
-			expr rhs = z3_ctx.bool_val(true);
-			z3_taint_solver.add(lhs == rhs);
-
-//		std::cerr << "constraint : " << (lhs == rhs) << "\n";
-
+			expr tag = z3_ctx.bool_const(varName.c_str());
+			vector<expr> query;
+			query.push_back(tag);
 			Event* curr = trace->getEvent((*it));
 			for (unsigned j = 0; j < ifFormula.size(); j++) {
 				Event* temp = ifFormula[j].first;
 				expr currIf = z3_ctx.int_const(curr->eventName.c_str());
 				expr tempIf = z3_ctx.int_const(temp->eventName.c_str());
-				expr constraint = z3_ctx.bool_val(1);
 				if (curr->threadId == temp->threadId) {
 					if (curr->eventId > temp->eventId)
-						constraint = ifFormula[j].second;
+						query.push_back(ifFormula[j].second);
 				} else
-					constraint = implies(tempIf < currIf, ifFormula[j].second);
-				z3_taint_solver.add(constraint);
-			}
-			check_result result;
-			try {
-				result = z3_taint_solver.check();
-			} catch (z3::exception & ex) {
-				std::cerr << "\nUnexpected error: " << ex.msg() << "\n";
-				continue;
+					query.push_back(implies(tempIf < currIf, ifFormula[j].second));
 			}
-			if (result == z3::sat) {
-				taintPTS.push_back(*it);
-				if (DTAMhybrid.find(*it) == DTAMhybrid.end()) {
-					std::cerr << "taintPTS : " << *it << "\n";
-					std::cerr << "DTAMhybrid not find" << "\n";
-					model m = z3_taint_solver.get_model();
-//				std::cerr << "z3_taint_solver.get_model() \n" << m;
-				} else {
-					std::cerr << "taintPTS : " << *it << "\n";
-					std::cerr << "DTAMhybrid find" << "\n";
-					std::cerr << "getLine : " << trace->getLine(*it) << "\n";
+			queries.push_back(makeExprsAnd(query));
+		}
+		gettimeofday(&finish, NULL);
+		runtimeData->PTSBuildCost += (double) (finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL
+				- start.tv_usec) / 1000000UL;
+
+		gettimeofday(&start, NULL);
+		PTSWork work;
+		work.state.assign(PTS.size(), PTSUndecided);
+		work.next = 0;
+		work.limited = EncodeTraceBudget != 0;
+		work.left = EncodeTraceBudget - budgetCost;
+		work.cost = 0;
+		work.timeoutQuery = 0;
+		work.unknownQuery = 0;
+		pthread_mutex_init(&work.lock, NULL);
+		unsigned threadNum = EncodePTSThreads ? EncodePTSThreads : 1;
+		if (threadNum > PTS.size()) {
+			threadNum = PTS.size();
+		}
+		if (threadNum <= 1) {
+			PTSWorker worker(z3_taint_solver, &work);
+			worker.queries = queries;
+			checkPTS(&worker);
+		} else {
+			//copy the formula into the context of every worker before any of them starts
+			expr_vector assertions = z3_taint_solver.assertions();
+			vector<context*> contexts;
+			vector<PTSWorker*> workers;
+			for (unsigned k = 0; k < threadNum; k++) {
+				context *ctx = new context();
+				solver s(*ctx);
+				for (unsigned i = 0; i < assertions.size(); i++) {
+					s.add(expr(*ctx, Z3_translate(z3_ctx, assertions[i], *ctx)));
 				}
-//			std::cerr << "taintPTS : " << *it << "\n";
-//			std::cerr << "z3_taint_solver \n" << z3_taint_solver;
-				model m = z3_taint_solver.get_model();
-//			std::cerr << "z3_taint_solver.get_model() \n" << m;
-				for (std::vector<std::string>::iterator itt = it; itt != PTS.end(); itt++) {
-					stringstream ss;
-					ss << m.eval(z3_ctx.bool_const((*itt).c_str()));
-					long isTaint = atoi(ss.str().c_str());
-					if (isTaint != 0) {
-						taintPTS.push_back(*itt);
-						std::cerr << "taintPTS : " << *itt << "\n";
-						itt--;
-						PTS.erase(itt);
-					}
+				PTSWorker *worker = new PTSWorker(s, &work);
+				for (unsigned i = 0; i < queries.size(); i++) {
+					worker->queries.push_back(expr(*ctx, Z3_translate(z3_ctx, queries[i], *ctx)));
 				}
-
-				PTS.erase(it);
+				contexts.push_back(ctx);
+				workers.push_back(worker);
+			}
+			vector<pthread_t> threads(threadNum);
+			for (unsigned k = 0; k < threadNum; k++) {
+				pthread_create(&threads[k], NULL, checkPTS, workers[k]);
+			}
+			for (unsigned k = 0; k < threadNum; k++) {
+				pthread_join(threads[k], NULL);
+				delete workers[k];
+				delete contexts[k];
+			}
+		}
+		pthread_mutex_destroy(&work.lock);
+		budgetCost += work.cost;
+		runtimeData->timeoutQuery += work.timeoutQuery;
+		runtimeData->unknownQuery += work.unknownQuery;
+		gettimeofday(&finish, NULL);
+		runtimeData->PTSSolveCost += (double) (finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL
+				- start.tv_usec) / 1000000UL;
+
+		for (unsigned i = 0; i < PTS.size(); i++) {
+			if (work.state[i] == PTSTaint) {
+				taintPTS.push_back(PTS[i]);
+				std::cerr << "taintPTS : " << PTS[i] << "\n";
 			} else {
-				noTaintPTS.push_back(*it);
-
-				if (DTAMhybrid.find(*it) == DTAMhybrid.end()) {
-					std::cerr << "noTaintPTS : " << *it << "\n";
-					std::cerr << "DTAMhybrid not find" << "\n";
-//				std::cerr << "z3_taint_solver \n" << z3_taint_solver;
-				} else {
-					std::cerr << "noTaintPTS : " << *it << "\n";
-					std::cerr << "DTAMhybrid find" << "\n";
-					std::cerr << "getLine : " << trace->getLine(*it) << "\n";
-				}
-				PTS.erase(it);
+				noTaintPTS.push_back(PTS[i]);
+				std::cerr << "noTaintPTS : " << PTS[i] << "\n";
+			}
+			if (DTAMhybrid.find(PTS[i]) == DTAMhybrid.end()) {
+				std::cerr << "DTAMhybrid not find" << "\n";
+			} else {
+				std::cerr << "DTAMhybrid find" << "\n";
+				std::cerr << "getLine : " << trace->getLine(PTS[i]) << "\n";
 			}
-			z3_taint_solver.pop();
 		}
+		PTS.clear();
 		runtimeData->taint.push_back(DTAMSerial.size());
 		runtimeData->taintPTS.push_back(taintPTS.size());
 		runtimeData->noTaintPTS.push_back(noTaintPTS.size());
@@ -562,67 +951,44 @@ namespace klee {
 	}
 
 	void Encode::computePrefix(vector<Event*>& vecEvent, Event* ifEvent) {
-		vector<struct Pair *> eventOrderPair;
+		model m = getModel();
 //get the order of event
-		map<string, expr>::iterator it = eventNameInZ3.find(ifEvent->eventName);
-		assert(it != eventNameInZ3.end());
-		model m = z3_solver.get_model();
-		stringstream ss;
-		ss << m.eval(it->second);
-		long ifEventOrder = atoi(ss.str().c_str());
-		for (unsigned tid = 0; tid < trace->eventList.size(); tid++) {
-			std::vector<Event*>* thread = trace->eventList[tid];
-			if (thread == NULL)
+		int ifEventOrder = evalOrder(z3_ctx, m, z3_ctx.int_const(ifEvent->eventName.c_str()));
+		vector<Pair> eventOrderPair;
+		eventOrderPair.reserve(eventOrderInZ3.size());
+		for (vector<pair<Event*, expr> >::iterator it = eventOrderInZ3.begin(), ie = eventOrderInZ3.end(); it != ie; it++) {
+			Event* event = it->first;
+			int order = evalOrder(z3_ctx, m, it->second);
+			//cut off segment behind the negated branch
+			if (order > ifEventOrder)
 				continue;
-			for (unsigned index = 0, size = thread->size(); index < size; index++) {
-				if (thread->at(index)->eventType == Event::VIRTUAL)
+			if (order == ifEventOrder) {
+				if (event->threadId != ifEvent->threadId)
 					continue;
-
-				it = eventNameInZ3.find(thread->at(index)->eventName);
-				assert(it != eventNameInZ3.end());
-				stringstream ss;
-				ss << m.eval(it->second);
-				long order = atoi(ss.str().c_str());
-				//cut off segment behind the negated branch
-				if (order > ifEventOrder)
+				//same order in the same thread means the same cluster as ifEvent
+				if (event->eventId > ifEvent->eventId)
 					continue;
-				if (order == ifEventOrder && thread->at(index)->threadId != ifEvent->threadId)
-					continue;
-				if (thread->at(index)->eventName == ifEvent->eventName && thread->at(index)->eventId > ifEvent->eventId)
-					continue;
-				//put the event to its position
-				//
-				Pair * pair = new Pair;				//should be deleted
-				pair->order = order;
-				pair->event = thread->at(index);
-				eventOrderPair.push_back(pair);
 			}
+			Pair pair;
+			pair.order = order;
+			pair.event = event;
+			eventOrderPair.push_back(pair);
 		}
 
-//sort all events according to order
-		unsigned size = eventOrderPair.size();
-		for (unsigned i = 0; i < size - 1; i++) {
-			for (unsigned j = 0; j < size - i - 1; j++) {
-				if (eventOrderPair[j]->order > eventOrderPair[j + 1]->order) {
-					Pair *temp = eventOrderPair[j];
-					eventOrderPair[j] = eventOrderPair[j + 1];
-					eventOrderPair[j + 1] = temp;
-				}
-			}
-		}
+//sort all events according to order, events of one cluster keep their thread order
+		std::stable_sort(eventOrderPair.begin(), eventOrderPair.end(), lessOrder);
 
 //put the ordered events to vecEvent.
-		for (unsigned i = 0; i < eventOrderPair.size(); i++) {
-			//TODO: use a simple struct to log prefix
-			vecEvent.push_back(eventOrderPair[i]->event);
-			delete eventOrderPair[i];
+		vecEvent.reserve(vecEvent.size() + eventOrderPair.size());
+		for (vector<Pair>::iterator it = eventOrderPair.begin(), ie = eventOrderPair.end(); it != ie; it++) {
+			vecEvent.push_back(it->event);
 		}
 	}
 
 	void Encode::showPrefixInfo(Prefix* prefix, Event* ifEvent) {
 		vector<Event*>* orderedEventList = prefix->getEventList();
 		unsigned size = orderedEventList->size();
-		model m = z3_solver.get_model();
+		model m = getModel();
 //print counterexample at bitcode
 		string ErrorInfo;
 		stringstream output;
@@ -846,7 +1212,7 @@ namespace klee {
 //	out << "#Constaints: " << constaintNumber << "\n";
 	}
 
-	void Encode::buildInitValueFormula(solver z3_solver_init) {
+	void Encode::buildInitValueFormula(solver z3_solver_init, vector<pair<string, expr> > *sliced) {
 //for global initializer
 #if FORMULA_DEBUG
 		std::cerr << "\nGlobal var initial value:\n";
@@ -862,6 +1228,9 @@ namespace klee {
 			expr lhs = z3_ctx.constant(str.c_str(), varType);
 			expr rhs = buildExprForConstantValue(gvi->second, false, "");
 			z3_solver_init.add(lhs == rhs);
+			if (sliced) {
+				sliced->push_back(make_pair(gvi->first, lhs == rhs));
+			}
 
 #if FORMULA_DEBUG
 			std::cerr << (lhs == rhs) << "\n";
@@ -939,7 +1308,8 @@ namespace klee {
 //			if (event->usefulGlobal) {
 				if (event->isGlobal) {
 					Instruction *I = event->inst->inst;
-					if (StoreInst::classof(I)) { //write
+					//an atomic read-modify-write is its read and a virtual write behind it, see PSOListener
+					if (StoreInst::classof(I) || isAtomicWrite(event)) { //write
 						latestWriteOneThread[event->name] = event;
 					} else { //read
 						Event * writeEvent;
@@ -960,17 +1330,18 @@ namespace klee {
 		}
 	}
 
-	void Encode::buildPathCondition(solver z3_solver_pc) {
+	void Encode::buildPathCondition(solver z3_solver_pc, vector<pair<string, expr> > *sliced) {
 #if FORMULA_DEBUG
 		std::cerr << "\nBasicFormula:\n";
 #endif
 
-		KQuery2Z3 *kq = new KQuery2Z3(z3_ctx);
-		;
 		unsigned int totalExpr = trace->pathConditionRelatedToBranch.size();
 		for (unsigned int i = 0; i < totalExpr; i++) {
-			z3::expr temp = kq->getZ3Expr(trace->pathConditionRelatedToBranch[i]);
+			z3::expr temp = kq.getZ3Expr(trace->pathConditionRelatedToBranch[i]);
 			z3_solver_pc.add(temp);
+			if (sliced) {
+				sliced->push_back(make_pair(FilterSymbolicExpr::getName(trace->pathConditionRelatedToBranch[i]->getKid(1)), temp));
+			}
 #if FORMULA_DEBUG
 			std::cerr << temp << "\n";
 #endif
@@ -1018,7 +1389,19 @@ namespace klee {
 		}
 		runtimeData->brGlobal += brGlobal;
 
-		KQuery2Z3 * kq = new KQuery2Z3(z3_ctx);
+		strategy = selectSolverStrategy();
+		if (cache && cache->getStrategy() != -1) {
+			//a solver that can solve this trace keeps the formulas shared with the former ones
+			SolverStrategy shared = (SolverStrategy) cache->getStrategy();
+			if (shared == DefaultStrategy || (shared == LIAStrategy && strategy == IDLStrategy)) {
+				strategy = shared;
+			}
+		}
+		z3_solver = makeSolver(strategy);
+		z3_taint_solver = makeSolver(strategy);
+#if BRANCH_INFO
+		std::cerr << "Solver strategy: " << getStrategyName(strategy) << "\n";
+#endif
 
 		unsigned int totalAssertEvent = trace->assertEvent.size();
 		unsigned int totalAssertSymbolic = trace->assertSymbolicExpr.size();
@@ -1028,7 +1411,7 @@ namespace klee {
 		for (unsigned int i = 0; i < totalAssertEvent; i++) {
 			event = trace->assertEvent[i];
 //		std::cerr << "asert : " << trace->assertSymbolicExpr[i] <<"\n";
-			res = kq->getZ3Expr(trace->assertSymbolicExpr[i]);
+			res = kq.getZ3Expr(trace->assertSymbolicExpr[i]);
 //		string fileName = event->inst->info->file;
 			unsigned line = event->inst->info->line;
 			if (line != 0)
@@ -1042,8 +1425,9 @@ namespace klee {
 		for (unsigned int i = 0; i < totalBrEvent; i++) {
 			event = trace->brEvent[i];
 //		std::cerr << "br : " << trace->brSymbolicExpr[i] <<"\n";
-			res = kq->getZ3Expr(trace->brSymbolicExpr[i]);
+			res = kq.getZ3Expr(trace->brSymbolicExpr[i]);
 			if (event->isConditionInst == true) {
+				ifBrIndex.push_back(i);
 //			event->inst->inst->dump();
 //			string fileName = event->inst->info->file;
 //			unsigned line = event->inst->info->line;
@@ -1053,19 +1437,424 @@ namespace klee {
 //			std::cerr << "constraint : " << ifFormula[i].second << "\n";
 			} else if (event->isConditionInst == false) {
 				z3_solver.add(res);
+				implicitBrFormula.push_back(make_pair(i, res));
 			}
 		}
 
 		unsigned int totalRwExpr = trace->rwSymbolicExpr.size();
 		for (unsigned int i = 0; i < totalRwExpr; i++) {
 			event = trace->rwEvent[i];
-			res = kq->getZ3Expr(trace->rwSymbolicExpr[i]);
+			res = kq.getZ3Expr(trace->rwSymbolicExpr[i]);
 			rwFormula.push_back(make_pair(event, res));
 //		std::cerr << "rwSymbolicExpr : " << res << "\n";
 		}
 		buildAllFormula();
 	}
 
+	const char* Encode::getStrategyName(SolverStrategy strategy) {
+		switch (strategy) {
+			case IDLStrategy:
+				return "idl";
+			case LIAStrategy:
+				return "lia";
+			case BVStrategy:
+				return "bv";
+			case AutoStrategy:
+				return "auto";
+			default:
+				return "default";
+		}
+	}
+
+	solver Encode::makeSolver(SolverStrategy strategy) {
+		switch (strategy) {
+			case IDLStrategy:
+				return solver(z3_ctx, "QF_IDL");
+			case LIAStrategy:
+				return solver(z3_ctx, "QF_LIA");
+			case BVStrategy: {
+				//order variables are int, data is bit-vector: let solve-eqs eliminate
+				//the read-from equalities before the smt core sees them
+				tactic pipeline = tactic(z3_ctx, "simplify") & tactic(z3_ctx, "propagate-values") & tactic(z3_ctx, "solve-eqs")
+						& tactic(z3_ctx, "smt");
+				return pipeline.mk_solver();
+			}
+			default:
+				return solver(z3_ctx);
+		}
+	}
+
+	/*
+	 * all order variables are int_const. if no data term of KQuery2Z3 survives
+	 * the filter, the formula is pure ordering and a difference logic solver is
+	 * enough, wait/signal matching is boolean and keeps it there.
+	 */
+	SolverStrategy Encode::selectSolverStrategy() {
+		//a tactic pipeline solves every check from scratch and reports no unsat cores,
+		//the pruning by cores and the shared solver need an incremental one
+		bool incremental = EncodeUnsatCorePruning || EncodeIncremental;
+		if (EncodeSolverStrategy != AutoStrategy) {
+			if (EncodeSolverStrategy == BVStrategy && incremental) {
+				klee_warning_once(0, "-encode-solver-strategy=bv is not incremental, using the default solver"
+						" (disable -encode-unsat-core-pruning and -encode-incremental to use it)");
+				return DefaultStrategy;
+			}
+			return EncodeSolverStrategy;
+		}
+		bool hasData = !trace->pathConditionRelatedToBranch.empty() || !trace->brSymbolicExpr.empty()
+				|| !trace->assertSymbolicExpr.empty() || !trace->rwSymbolicExpr.empty() || !trace->readSetRelatedToBranch.empty()
+				|| !trace->global_variable_initializer_RelatedToBranch.empty();
+		if (hasData) {
+#if INT_ARITHMETIC
+			return LIAStrategy;
+#else
+			return incremental ? DefaultStrategy : BVStrategy;
+#endif
+		}
+		//the chain encoding of locks uses uninterpreted functions
+		map<string, vector<LockPair *> >::iterator it = trace->all_lock_unlock.begin();
+		for (; it != trace->all_lock_unlock.end(); it++) {
+			if (useLockChain(it->second)) {
+				return DefaultStrategy;
+			}
+		}
+		return IDLStrategy;
+	}
+
+	//check the current query within timeout ms and what is left of the trace budget,
+	//unknown if either runs out or z3 fails
+	check_result Encode::solveQuery(unsigned timeout) {
+		if (EncodeTraceBudget) {
+			double left = EncodeTraceBudget - budgetCost;
+			if (left <= 0) {
+				if (!retrying) {
+					runtimeData->timeoutQuery++;
+				}
+				return z3::unknown;
+			}
+			unsigned leftMs = (unsigned) (left * 1000) + 1;
+			if (!timeout || leftMs < timeout) {
+				timeout = leftMs;
+			}
+		}
+		params p(z3_ctx);
+		//0 leaves z3 without limit
+		p.set("timeout", timeout ? timeout : UINT_MAX);
+		if (EncodeQueryRlimit) {
+			p.set("rlimit", (unsigned) EncodeQueryRlimit);
+		}
+
+		check_result result;
+		struct timeval start, finish;
+		gettimeofday(&start, NULL);
+		solvedByKlee = false;
+		try {
+			if (kleeSolver) {
+				solvedByKlee = solveWithKlee(timeout, result);
+				if (!solvedByKlee) {
+					runtimeData->kleeFallbackQuery++;
+				}
+			}
+			if (!solvedByKlee) {
+				z3_solver.set(p);
+				result = checkBase();
+			}
+		} catch (z3::exception & ex) {
+			std::cerr << "\nUnexpected error: " << ex.msg() << "\n";
+			result = z3::unknown;
+		}
+		gettimeofday(&finish, NULL);
+		budgetCost += (double) (finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
+
+		if (result == z3::unknown && !retrying) {
+			bool timedOut;
+			if (solvedByKlee) {
+				//klee does not tell a timeout from other failures
+				timedOut = timeout != 0;
+			} else {
+				string reason = z3_solver.reason_unknown();
+				timedOut = reason.find("timeout") != string::npos || reason.find("canceled") != string::npos
+						|| reason.find("resource") != string::npos;
+			}
+			if (timedOut) {
+				runtimeData->timeoutQuery++;
+			} else {
+				runtimeData->unknownQuery++;
+			}
+		}
+		return result;
+	}
+
+	/*
+	 * solve the current query with the solver chain of klee. the assertions
+	 * before markQueryStart() and baseAssumptions are the constraints, the real
+	 * run of the trace satisfies them as klee requires. the rest of the
+	 * assertions and queryAssumptions are the expression given to mayBeTrue.
+	 * false if a formula can not be lowered, z3 has to solve the query then.
+	 */
+	//split the conjunction e into base, false if one of its parts folds to false
+	static bool addBaseConstraint(vector<ref<Expr> > &base, ref<Expr> e) {
+		if (ConstantExpr *ce = dyn_cast<ConstantExpr>(e)) {
+			return ce->isTrue();
+		}
+		if (AndExpr *ae = dyn_cast<AndExpr>(e)) {
+			return addBaseConstraint(base, ae->left) && addBaseConstraint(base, ae->right);
+		}
+		base.push_back(e);
+		return true;
+	}
+
+	bool Encode::solveWithKlee(unsigned timeout, check_result &result) {
+		expr_vector assertions = z3_solver.assertions();
+		//the base is taken as it is: ConstraintManager::addConstraint asserts on a
+		//constraint that is false, also one that only gets false by the rewriting of
+		//a later equality. a base without model is found unsat by the solver instead
+		vector<ref<Expr> > base;
+		bool feasible = true;
+		ref<Expr> query = ConstantExpr::alloc(1, Expr::Bool);
+		for (unsigned i = 0; i < assertions.size(); i++) {
+			ref<Expr> e;
+			if (!toKQuery.getKQuery(assertions[i], e)) {
+				return false;
+			}
+			if (i < baseAssertionNum) {
+				feasible = addBaseConstraint(base, e) && feasible;
+			} else {
+				query = AndExpr::create(query, e);
+			}
+		}
+		for (unsigned i = 0; i < baseAssumptions.size(); i++) {
+			ref<Expr> e;
+			if (!toKQuery.getKQuery(baseAssumptions[i], e)) {
+				return false;
+			}
+			feasible = addBaseConstraint(base, e) && feasible;
+		}
+		for (unsigned i = 0; i < queryAssumptions.size(); i++) {
+			ref<Expr> e;
+			if (!toKQuery.getKQuery(queryAssumptions[i], e)) {
+				return false;
+			}
+			query = AndExpr::create(query, e);
+		}
+		if (!feasible || query->isFalse()) {
+			runtimeData->kleeQuery++;
+			result = z3::unsat;
+			return true;
+		}
+		ConstraintManager constraints(base);
+
+		runtimeData->kleeQuery++;
+		kleeSolver->setCoreSolverTimeout(timeout / 1000.0);
+		bool mayBeTrue;
+		if (!kleeSolver->mayBeTrue(Query(constraints, query), mayBeTrue)) {
+			result = z3::unknown;
+			return true;
+		}
+		if (!mayBeTrue) {
+			result = z3::unsat;
+			return true;
+		}
+		//getInitialValues looks for an assignment that falsifies the expression
+		vector<vector<unsigned char> > values;
+		if (!kleeSolver->getInitialValues(Query(constraints, Expr::createIsZero(query)), toKQuery.getObjects(), values)) {
+			result = z3::unknown;
+			return true;
+		}
+		kleeModel = toKQuery.getModel(values);
+		result = z3::sat;
+		return true;
+	}
+
+	//the assertions added from now on belong to the query, not to the trace
+	void Encode::markQueryStart() {
+		if (kleeSolver) {
+			baseAssertionNum = z3_solver.assertions().size();
+		}
+	}
+
+	model Encode::getModel() {
+		if (solvedByKlee) {
+			return kleeModel;
+		}
+		return z3_solver.get_model();
+	}
+
+	check_result Encode::checkBase() {
+		if (queryAssumptions.size() == 0) {
+			if (baseAssumptions.size() == 0) {
+				return z3_solver.check();
+			}
+			return z3_solver.check(baseAssumptions);
+		}
+		expr_vector assumptions(z3_ctx);
+		for (unsigned i = 0; i < baseAssumptions.size(); i++) {
+			assumptions.push_back(baseAssumptions[i]);
+		}
+		for (unsigned i = 0; i < queryAssumptions.size(); i++) {
+			assumptions.push_back(queryAssumptions[i]);
+		}
+		return z3_solver.check(assumptions);
+	}
+
+	/*
+	 * the base formula is the same for every branch query of a trace, only the
+	 * constraints added here differ. each one is guarded by a literal named after
+	 * its ast id, so an unsat core over these literals also refutes every later
+	 * query that contains the same constraints.
+	 */
+	void Encode::addQueryConstraint(expr constraint) {
+		if (!EncodeUnsatCorePruning) {
+			z3_solver.add(constraint);
+			return;
+		}
+		unsigned id = Z3_get_ast_id(z3_ctx, constraint);
+		//keep the constraint alive so that its id is not reused
+		queryConstraints.insert(make_pair(id, constraint));
+		stringstream ss;
+		ss << "_Q" << id;
+		expr literal = z3_ctx.bool_const(ss.str().c_str());
+		z3_solver.add(implies(literal, constraint));
+		queryAssumptions.push_back(literal);
+		queryIds.push_back(id);
+	}
+
+	void Encode::clearQueryConstraints() {
+		queryAssumptions = expr_vector(z3_ctx);
+		queryIds.clear();
+	}
+
+	bool Encode::implyKnownCore() {
+		if (unsatCores.empty()) {
+			return false;
+		}
+		std::sort(queryIds.begin(), queryIds.end());
+		for (unsigned i = 0; i < unsatCores.size(); i++) {
+			if (std::includes(queryIds.begin(), queryIds.end(), unsatCores[i].begin(), unsatCores[i].end())) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void Encode::recordUnsatCore() {
+		//klee does not report cores
+		if (!EncodeUnsatCorePruning || solvedByKlee) {
+			return;
+		}
+		vector<unsigned> core;
+		try {
+			expr_vector literals = z3_solver.unsat_core();
+			for (unsigned i = 0; i < literals.size(); i++) {
+				//the indicators of the shared solver are in every query of the trace
+				string name = literals[i].decl().name().str();
+				if (name.compare(0, 2, "_Q") == 0) {
+					core.push_back(atoi(name.c_str() + 2));
+				}
+			}
+		} catch (z3::exception & ex) {
+			return;
+		}
+		//an empty core may also come from a solver that does not track assumptions
+		if (core.empty()) {
+			return;
+		}
+		std::sort(core.begin(), core.end());
+		core.erase(std::unique(core.begin(), core.end()), core.end());
+		unsatCores.push_back(core);
+	}
+
+	/*
+	 * write the current query as a self-contained SMT-LIB2 file for encode-bench.
+	 * the header lines starting with ';' carry the metadata of the query.
+	 */
+	void Encode::dumpQuery(string queryName, Event* event) {
+		if (EncodeDumpQueries.empty()) {
+			return;
+		}
+		expr_vector assertions = z3_solver.assertions();
+		vector<Z3_ast> asts;
+		for (unsigned i = 0; i < assertions.size(); i++) {
+			asts.push_back(assertions[i]);
+		}
+		//the indicators of the shared solver and of the query constraints are part of the query
+		for (unsigned i = 0; i < baseAssumptions.size(); i++) {
+			asts.push_back(baseAssumptions[i]);
+		}
+		for (unsigned i = 0; i < queryAssumptions.size(); i++) {
+			asts.push_back(queryAssumptions[i]);
+		}
+		expr formula = z3_ctx.bool_val(true);
+		if (!asts.empty()) {
+			formula = to_expr(z3_ctx, asts.back());
+			asts.pop_back();
+		}
+		unsigned readNum = 0, writeNum = 0;
+		for (map<string, vector<Event *> >::iterator nit = trace->readSet.begin(), nie = trace->readSet.end(); nit != nie; ++nit) {
+			readNum += nit->second.size();
+		}
+		for (map<string, vector<Event *> >::iterator nit = trace->writeSet.begin(), nie = trace->writeSet.end(); nit != nie; ++nit) {
+			writeNum += nit->second.size();
+		}
+
+		stringstream fileName;
+		fileName << EncodeDumpQueries << "/" << queryName << ".smt2";
+		std::ofstream out_file(fileName.str().c_str(), std::ios_base::out);
+		out_file << "; trace: " << trace->Id << "\n";
+		out_file << "; line: " << event->inst->info->line << "\n";
+		out_file << "; event: " << event->eventName << "\n";
+		out_file << "; events: " << trace->path.size() << "\n";
+		out_file << "; reads: " << readNum << "\n";
+		out_file << "; writes: " << writeNum << "\n";
+		out_file << "; strategy: " << getStrategyName(strategy) << "\n";
+		out_file << Z3_benchmark_to_smtlib_string(z3_ctx, queryName.c_str(), "", "unknown", "", asts.size(),
+				asts.empty() ? NULL : &asts[0], formula);
+		out_file.close();
+	}
+
+	/*
+	 * solve the current query of z3_solver once per strategy.
+	 * the line format is: queryName strategy:result:cost ...
+	 */
+	void Encode::benchmarkStrategies(string queryName) {
+		const SolverStrategy strategies[] = { DefaultStrategy, IDLStrategy, LIAStrategy, BVStrategy };
+		expr_vector assertions = z3_solver.assertions();
+		std::ofstream out_file("./output_info/strategy.txt", std::ios_base::out | std::ios_base::app);
+		out_file << queryName;
+		for (unsigned i = 0; i < sizeof(strategies) / sizeof(strategies[0]); i++) {
+			struct timeval start, finish;
+			gettimeofday(&start, NULL);
+			string result;
+			try {
+				solver s = makeSolver(strategies[i]);
+				for (unsigned j = 0; j < assertions.size(); j++) {
+					s.add(assertions[j]);
+				}
+				for (unsigned j = 0; j < baseAssumptions.size(); j++) {
+					s.add(baseAssumptions[j]);
+				}
+				for (unsigned j = 0; j < queryAssumptions.size(); j++) {
+					s.add(queryAssumptions[j]);
+				}
+				check_result r = s.check();
+				if (r == z3::sat) {
+					result = "sat";
+				} else if (r == z3::unsat) {
+					result = "unsat";
+				} else {
+					result = "unknown";
+				}
+			} catch (z3::exception & ex) {
+				result = "error";
+			}
+			gettimeofday(&finish, NULL);
+			double cost = (double) (finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
+			out_file << " " << getStrategyName(strategies[i]) << ":" << result << ":" << cost;
+		}
+		out_file << "\n";
+		out_file.close();
+	}
+
 	expr Encode::buildExprForConstantValue(Value *V, bool isLeft, string currInstPrefix) {
 		assert(V && "V is null!");
 		expr ret = z3_ctx.bool_val(1);
@@ -1245,6 +2034,20 @@ namespace klee {
 			formulaNum += 2;
 		}
 
+//order variable of every event, computePrefix reads them back from the model
+		eventOrderInZ3.clear();
+		for (unsigned tid = 0; tid < trace->eventList.size(); tid++) {
+			std::vector<Event*>* thread = trace->eventList[tid];
+			if (thread == NULL)
+				continue;
+			for (unsigned index = 0, size = thread->size(); index < size; index++) {
+				Event* event = thread->at(index);
+				if (event->eventType == Event::VIRTUAL)
+					continue;
+				eventOrderInZ3.push_back(make_pair(event, z3_ctx.int_const(event->eventName.c_str())));
+			}
+		}
+
 //normal events
 		int uniqueEvent = 1;
 		for (unsigned tid = 0; tid < trace->eventList.size(); tid++) {
@@ -1267,10 +2070,6 @@ namespace klee {
 				z3_solver_mm.add(temp);
 				//statics
 				formulaNum++;
-
-				//eventNameInZ3 will be used at check_if
-				eventNameInZ3.insert(map<string, expr>::value_type(pre->eventName, preExpr));
-				eventNameInZ3.insert(map<string, expr>::value_type(post->eventName, postExpr));
 			}
 		}
 		z3_solver_mm.add(z3_ctx.int_const("E_FINAL") == z3_ctx.int_val(uniqueEvent) + 100);
@@ -1295,6 +2094,11 @@ namespace klee {
 
 				for (unsigned index = 1, size = thread->size(); index < size; index++) {
 					Event* curr = thread->at(index);
+					//the write of an atomic read-modify-write keeps the order of its read
+					if (isAtomicWrite(curr)) {
+						curr->eventName = thread->at(index - 1)->eventName;
+						continue;
+					}
 					InstType currInstType = getInstOpType(curr);
 
 					//debug
@@ -1340,6 +2144,11 @@ namespace klee {
 
 				for (unsigned index = 1, size = thread->size(); index < size; index++) {
 					Event* curr = thread->at(index);
+					//the write of an atomic read-modify-write keeps the order of its read
+					if (isAtomicWrite(curr)) {
+						curr->eventName = thread->at(index - 1)->eventName;
+						continue;
+					}
 					InstType currInstType = getInstOpType(curr);
 
 					//debug
@@ -1442,13 +2251,11 @@ namespace klee {
 		formulaNum += trace->joinThreadPoint.size();
 	}
 
-	void Encode::buildReadWriteFormula(solver z3_solver_rw) {
+	//needs the latest writes of markLatestWriteForGlobalVar
+	void Encode::buildReadWriteFormula(solver z3_solver_rw, vector<pair<string, expr> > *sliced) {
 #if FORMULA_DEBUG
 		std::cerr << "\nReadWriteFormula:\n";
 #endif
-//prepare
-		markLatestWriteForGlobalVar();
-//
 //	std::cerr << "size : " << trace->readSet.size()<<"\n";
 //	std::cerr << "size : " << trace->writeSet.size()<<"\n";
 		map<string, vector<Event *> >::iterator read;
@@ -1490,7 +2297,11 @@ namespace klee {
 				//compute the write set that may be used by currentRead;
 				vector<Event *> mayBeRead;
 				unsigned currentWriteThreadId;
-				if (iw != trace->writeSetRelatedToBranch.end()) {
+				//a read of the write earlier in its own critical section can not
+				//see the writes of other threads, see LocksetPass
+				bool readsOwnWrite = currentRead->latestWriteEventInSameThread != NULL
+						&& (currentRead->inst->lockFacts & KInstruction::ReadsOwnWrite);
+				if (iw != trace->writeSetRelatedToBranch.end() && !readsOwnWrite) {
 					for (unsigned i = 0; i < iw->second.size(); i++) {
 						if (iw->second[i]->threadId == currentRead->threadId)
 							continue;
@@ -1571,6 +2382,9 @@ namespace klee {
 					std::cerr << oneReadExprs << "\n";
 #endif
 					z3_solver_rw.add(oneReadExprs);
+					if (sliced) {
+						sliced->push_back(make_pair(ir->first, oneReadExprs));
+					}
 				}
 			}
 		}
@@ -1645,6 +2459,131 @@ namespace klee {
 		return o;
 	}
 
+	bool Encode::useLockChain(vector<LockPair*> &lockPairs) {
+		return EncodeLockChainThreshold && lockPairs.size() > EncodeLockChainThreshold;
+	}
+
+	//vector clocks of the lock/unlock and wait/signal events over program order and thread
+	//create/join, the only synchronization that orders events in every schedule of this trace
+	void Encode::computeForkJoinClock(map<Event*, vector<unsigned> > &clocks) {
+		map<string, vector<LockPair *> >::iterator it = trace->all_lock_unlock.begin();
+		for (; it != trace->all_lock_unlock.end(); it++) {
+			for (unsigned i = 0; i < it->second.size(); i++) {
+				clocks[it->second[i]->lockEvent];
+				if (it->second[i]->unlockEvent != NULL) {
+					clocks[it->second[i]->unlockEvent];
+				}
+			}
+		}
+		map<string, vector<Wait_Lock *> >::iterator it_wait = trace->all_wait.begin();
+		for (; it_wait != trace->all_wait.end(); it_wait++) {
+			for (unsigned i = 0; i < it_wait->second.size(); i++) {
+				clocks[it_wait->second[i]->wait];
+				clocks[it_wait->second[i]->lock_by_wait];
+			}
+		}
+		map<string, vector<Event *> >::iterator it_signal = trace->all_signal.begin();
+		for (; it_signal != trace->all_signal.end(); it_signal++) {
+			for (unsigned i = 0; i < it_signal->second.size(); i++) {
+				clocks[it_signal->second[i]];
+			}
+		}
+		if (clocks.empty()) {
+			return;
+		}
+		unsigned threadNum = trace->eventList.size();
+		vector<vector<unsigned> > threadClock(threadNum, vector<unsigned>(threadNum, 0));
+		for (vector<Event*>::iterator pi = trace->path.begin(), pe = trace->path.end(); pi != pe; pi++) {
+			Event* event = *pi;
+			vector<unsigned> &curr = threadClock[event->threadId];
+			map<Event*, uint64_t>::iterator itj = trace->joinThreadPoint.find(event);
+			if (itj != trace->joinThreadPoint.end()) {
+				vector<unsigned> &joined = threadClock[itj->second];
+				for (unsigned i = 0; i < threadNum; i++) {
+					if (curr[i] < joined[i])
+						curr[i] = joined[i];
+				}
+			}
+			curr[event->threadId]++;
+			map<Event*, vector<unsigned> >::iterator itc = clocks.find(event);
+			if (itc != clocks.end()) {
+				itc->second = curr;
+			}
+			map<Event*, uint64_t>::iterator itt = trace->createThreadPoint.find(event);
+			if (itt != trace->createThreadPoint.end()) {
+				vector<unsigned> &created = threadClock[itt->second];
+				for (unsigned i = 0; i < threadNum; i++) {
+					if (created[i] < curr[i])
+						created[i] = curr[i];
+				}
+			}
+		}
+	}
+
+	bool Encode::happensBefore(map<Event*, vector<unsigned> > &clocks, Event* one, Event* two) {
+		if (one == NULL || two == NULL)
+			return false;
+		vector<unsigned> &oneClock = clocks[one];
+		vector<unsigned> &twoClock = clocks[two];
+		if (oneClock.empty() || twoClock.empty())
+			return false;
+		return oneClock[one->threadId] <= twoClock[one->threadId];
+	}
+
+	/*
+	 * mutual exclusion of one mutex in O(L) instead of O(L^2):
+	 * the complete critical sections get distinct ranks 0..K-1 (Sec is the inverse of
+	 * the rank) and the section of rank k releases the mutex before rank k+1 acquires it.
+	 */
+	void Encode::buildLockChainFormula(solver z3_solver_sync, string mutex, vector<LockPair*> &lockPairs,
+			map<Event*, vector<unsigned> > &clocks) {
+		z3::sort intSort = z3_ctx.int_sort();
+		func_decl acquire = z3_ctx.function(("Acq_" + mutex).c_str(), intSort, intSort);
+		func_decl release = z3_ctx.function(("Rel_" + mutex).c_str(), intSort, intSort);
+		func_decl section = z3_ctx.function(("Sec_" + mutex).c_str(), intSort, intSort);
+		vector<LockPair*> complete;
+		vector<LockPair*> incomplete;
+		for (unsigned i = 0; i < lockPairs.size(); i++) {
+			if (lockPairs[i]->unlockEvent == NULL) {
+				incomplete.push_back(lockPairs[i]);
+			} else {
+				complete.push_back(lockPairs[i]);
+			}
+		}
+		int rankNum = complete.size();
+		for (int k = 0; k < rankNum; k++) {
+			expr lock = z3_ctx.int_const(complete[k]->lockEvent->eventName.c_str());
+			expr unlock = z3_ctx.int_const(complete[k]->unlockEvent->eventName.c_str());
+			stringstream ss;
+			ss << "R_" << mutex << "_" << complete[k]->lockEvent->eventName;
+			expr rank = z3_ctx.int_const(ss.str().c_str());
+			z3_solver_sync.add(rank >= 0 && rank < rankNum);
+			z3_solver_sync.add(section(rank) == k);
+			z3_solver_sync.add(acquire(rank) == lock);
+			z3_solver_sync.add(release(rank) == unlock);
+			//statics
+			formulaNum += 4;
+		}
+		for (int k = 0; k + 1 < rankNum; k++) {
+			z3_solver_sync.add(release(z3_ctx.int_val(k)) < acquire(z3_ctx.int_val(k + 1)));
+			//statics
+			formulaNum++;
+		}
+		//a section that is never released comes after the sections of the other threads
+		for (unsigned j = 0; j < incomplete.size(); j++) {
+			expr twoLock = z3_ctx.int_const(incomplete[j]->lockEvent->eventName.c_str());
+			for (int k = 0; k < rankNum; k++) {
+				if (complete[k]->threadId == incomplete[j]->threadId
+						|| happensBefore(clocks, complete[k]->unlockEvent, incomplete[j]->lockEvent))
+					continue;
+				expr oneUnlock = z3_ctx.int_const(complete[k]->unlockEvent->eventName.c_str());
+				z3_solver_sync.add(oneUnlock < twoLock);
+				//statics
+				formulaNum++;
+			}
+		}
+	}
+
 	void Encode::buildSynchronizeFormula(solver z3_solver_sync) {
 #if FORMULA_DEBUG
 		std::cerr << "\nSynchronizeFormula:\n";
@@ -1652,9 +2591,11 @@ namespace klee {
 #endif
 
 //lock/unlock
+		map<Event*, vector<unsigned> > clocks;
+		computeForkJoinClock(clocks);
 		map<string, vector<LockPair *> >::iterator it = trace->all_lock_unlock.begin();
 		for (; it != trace->all_lock_unlock.end(); it++) {
-			vector<LockPair*> tempVec = it->second;
+			vector<LockPair*> &tempVec = it->second;
 			int size = tempVec.size();
 			/////////////////////debug/////////////////////////////
 			//print out all the read and write insts of global vars.
@@ -1666,6 +2607,10 @@ namespace klee {
 				}
 			}
 			/////////////////////debug/////////////////////////////
+			if (useLockChain(tempVec)) {
+				buildLockChainFormula(z3_solver_sync, it->first, tempVec, clocks);
+				continue;
+			}
 			for (int i = 0; i < size - 1; i++) {
 				expr oneLock = z3_ctx.int_const(tempVec[i]->lockEvent->eventName.c_str());
 				if (tempVec[i]->unlockEvent == NULL) {		//imcomplete lock pair
@@ -1675,6 +2620,10 @@ namespace klee {
 				for (int j = i + 1; j < size; j++) {
 					if (tempVec[i]->threadId == tempVec[j]->threadId)
 						continue;
+					//already ordered by thread create/join
+					if (happensBefore(clocks, tempVec[i]->unlockEvent, tempVec[j]->lockEvent)
+							|| happensBefore(clocks, tempVec[j]->unlockEvent, tempVec[i]->lockEvent))
+						continue;
 
 					expr twoLock = z3_ctx.int_const(tempVec[j]->lockEvent->eventName.c_str());
 					expr twinLockPairOrder = z3_ctx.bool_val(1);
@@ -1709,112 +2658,47 @@ namespace klee {
 			it_signal = trace->all_signal.find(it_wait->first);
 			if (it_signal == trace->all_signal.end())
 				assert(0 && "Something wrong with wait/signal data collection!");
-			vector<Wait_Lock *> waitSet = it_wait->second;
-			string currCond = it_wait->first;
+			vector<Wait_Lock *> &waitSet = it_wait->second;
+			vector<Event *> &signalSet = it_signal->second;
+			const string &currCond = it_wait->first;
+			//the match variables of each signal, for at most one wait per signal
+			vector<vector<expr> > signalMatch(signalSet.size());
 			for (unsigned i = 0; i < waitSet.size(); i++) {
 				vector<expr> possibleMap;
-				vector<expr> possibleValue;
-				expr wait = z3_ctx.int_const(waitSet[i]->wait->eventName.c_str());
-				expr lock_wait = z3_ctx.int_const(waitSet[i]->lock_by_wait->eventName.c_str());
-				vector<Event *> signalSet = it_signal->second;
+				Event* waitEvent = waitSet[i]->wait;
+				Event* lockEvent = waitSet[i]->lock_by_wait;
+				expr wait = z3_ctx.int_const(waitEvent->eventName.c_str());
+				expr lock_wait = z3_ctx.int_const(lockEvent->eventName.c_str());
 				for (unsigned j = 0; j < signalSet.size(); j++) {
-					if (waitSet[i]->wait->threadId == signalSet[j]->threadId)
+					//a signal of the same thread, before the wait or after the wait returns can't match
+					if (waitEvent->threadId == signalSet[j]->threadId || happensBefore(clocks, signalSet[j], waitEvent)
+							|| happensBefore(clocks, lockEvent, signalSet[j]))
 						continue;
 					expr signal = z3_ctx.int_const(signalSet[j]->eventName.c_str());
-					//Event_wait < Event_signal < lock_wait
-					expr exprs_0 = wait < signal && signal < lock_wait;
-
-					//m_w_s = 1
+					//m_w_s
 					stringstream ss;
-					ss << currCond << "_" << waitSet[i]->wait->eventName << "_" << signalSet[j]->eventName;
-					expr map_wait_signal = z3_ctx.int_const(ss.str().c_str());
-					expr exprs_1 = (map_wait_signal == 1);
-					//range: p_w_s = 0 or p_w_s = 1
-					expr exprs_2 = map_wait_signal >= 0 && map_wait_signal <= 1;
-
-					possibleMap.push_back(exprs_0 && exprs_1);
-					possibleValue.push_back(exprs_2);
+					ss << currCond << "_" << waitEvent->eventName << "_" << signalSet[j]->eventName;
+					expr map_wait_signal = z3_ctx.bool_const(ss.str().c_str());
+					//m_w_s -> Event_wait < Event_signal < lock_wait
+					z3_solver_sync.add(implies(map_wait_signal, wait < signal && signal < lock_wait));
+
+					possibleMap.push_back(map_wait_signal);
+					signalMatch[j].push_back(map_wait_signal);
 					//statics
-					formulaNum += 3;
+					formulaNum += 2;
 				}
-				expr one_wait = makeExprsOr(possibleMap);
-				expr wait_value = makeExprsAnd(possibleValue);
+				//Sigma m_w_s >= 1
+				expr one_wait = possibleMap.empty() ? z3_ctx.bool_val(false) : makeExprsOr(possibleMap);
 #if FORMULA_DEBUG
 				std::cerr << one_wait << "\n";
 #endif
 				z3_solver_sync.add(one_wait);
-				z3_solver_sync.add(wait_value);
-			}
-		}
-
-		//Sigma m_w_s <= 1
-		it_signal = trace->all_signal.begin();
-		for (; it_signal != trace->all_signal.end(); it_signal++) {
-			it_wait = trace->all_wait.find(it_signal->first);
-			if (it_wait == trace->all_wait.end())
-				continue;
-			vector<Event *> signalSet = it_signal->second;
-			string currCond = it_signal->first;
-			for (unsigned i = 0; i < signalSet.size(); i++) {
-				vector<Wait_Lock *> waitSet = it_wait->second;
-				string currSignalName = signalSet[i]->eventName;
-				vector<expr> mapLabel;
-				for (unsigned j = 0; j < waitSet.size(); j++) {
-					stringstream ss;
-					ss << currCond << "_" << waitSet[j]->wait->eventName << "_" << currSignalName;
-					expr map_wait_signal = z3_ctx.int_const(ss.str().c_str());
-					mapLabel.push_back(map_wait_signal);
-				}
-				expr sum = makeExprsSum(mapLabel);
-				expr relation = (sum <= 1);
-				z3_solver_sync.add(relation);
-			}
-		}
-
-		//Sigma m_s_w >= 1
-		it_wait = trace->all_wait.begin();
-		for (; it_wait != trace->all_wait.end(); it_wait++) {
-			it_signal = trace->all_signal.find(it_wait->first);
-			if (it_signal == trace->all_signal.end())
-				continue;
-			vector<Wait_Lock *> waitSet = it_wait->second;
-			string currCond = it_wait->first;
-			for (unsigned i = 0; i < waitSet.size(); i++) {
-				vector<Event *> signalSet = it_signal->second;
-				string currWaitName = waitSet[i]->wait->eventName;
-				vector<expr> mapLabel;
-				for (unsigned j = 0; j < signalSet.size(); j++) {
-					stringstream ss;
-					ss << currCond << "_" << currWaitName << "_" << signalSet[j]->eventName;
-					expr map_wait_signal = z3_ctx.int_const(ss.str().c_str());
-					mapLabel.push_back(map_wait_signal);
-				}
-				expr sum = makeExprsSum(mapLabel);
-				expr relation = (sum >= 1);
-				z3_solver_sync.add(relation);
 			}
-		}
-
-		//wipe off the w/s matching in the same thread
-		it_wait = trace->all_wait.begin();
-		for (; it_wait != trace->all_wait.end(); it_wait++) {
-			it_signal = trace->all_signal.find(it_wait->first);
-			if (it_signal == trace->all_signal.end())
-				continue;
-			vector<Wait_Lock *> waitSet = it_wait->second;
-			string currCond = it_wait->first;
-			for (unsigned i = 0; i < waitSet.size(); i++) {
-				vector<Event *> signalSet = it_signal->second;
-				string currWaitName = waitSet[i]->wait->eventName;
-				unsigned currThreadId = waitSet[i]->wait->threadId;
-				for (unsigned j = 0; j < signalSet.size(); j++) {
-					if (currThreadId == signalSet[j]->threadId) {
-						stringstream ss;
-						ss << currCond << "_" << currWaitName << "_" << signalSet[j]->eventName;
-						expr map_wait_signal = z3_ctx.int_const(ss.str().c_str());
-						z3_solver_sync.add(map_wait_signal == 0);
-					}
-				}
+			//Sigma m_w_s <= 1
+			for (unsigned j = 0; j < signalSet.size(); j++) {
+				stringstream ss;
+				ss << currCond << "_" << signalSet[j]->eventName;
+				buildAtMostOne(z3_solver_sync, signalMatch[j], ss.str());
 			}
 		}
 
@@ -1879,6 +2763,37 @@ namespace klee {
 		return ret;
 	}
 
+	/*
+	 * at most one of the boolean exprs is true. pairwise for a few of them,
+	 * otherwise the sequential counter with one auxiliary s_i per expr:
+	 * x_i -> s_i, s_i-1 -> s_i, x_i -> !s_i-1
+	 */
+	void Encode::buildAtMostOne(solver z3_solver_amo, vector<expr> &exprs, string name) {
+		unsigned size = exprs.size();
+		if (size <= 4) {
+			for (unsigned i = 0; i < size; i++) {
+				for (unsigned j = i + 1; j < size; j++) {
+					z3_solver_amo.add(!exprs[i] || !exprs[j]);
+					//statics
+					formulaNum++;
+				}
+			}
+			return;
+		}
+		expr prev = z3_ctx.bool_val(false);
+		for (unsigned i = 0; i < size; i++) {
+			stringstream ss;
+			ss << name << "_amo" << i;
+			expr curr = z3_ctx.bool_const(ss.str().c_str());
+			z3_solver_amo.add(implies(exprs[i], curr));
+			z3_solver_amo.add(implies(prev, curr));
+			z3_solver_amo.add(implies(exprs[i], !prev));
+			prev = curr;
+			//statics
+			formulaNum += 3;
+		}
+	}
+
 	void Encode::buildInitTaintFormula(solver z3_solver_it) {
 		std::map<std::string, llvm::Constant*>::iterator gvi = trace->global_variable_initializer.begin();
 		for (; gvi != trace->global_variable_initializer.end(); gvi++) {
@@ -10,6 +10,7 @@
 
 
 #include <z3++.h>
+#include <memory>
 #include <stack>
 #include <utility>
 
@@ -18,6 +19,9 @@
 #include "Event.h"
 #include "FilterSymbolicExpr.h"
 #include "RuntimeDataManager.h"
+#include "EncodeCache.h"
+#include "Z3ToKQuery.h"
+#include "klee/Solver.h"
 enum InstType {
 	NormalOp, GlobalVarOp, ThreadOp
 };
@@ -26,24 +30,44 @@ using namespace z3;
 using namespace std;
 namespace klee {
 
+//how the z3 solvers of Encode are built
+enum SolverStrategy {
+	DefaultStrategy, //z3 general purpose solver
+	IDLStrategy, //QF_IDL, only difference constraints over order variables
+	LIAStrategy, //QF_LIA, order variables plus linear sums
+	BVStrategy, //tactic pipeline for order variables mixed with bit-vector data
+	AutoStrategy //choose one of the above according to the trace
+};
+
 class Encode {
 private:
 	RuntimeDataManager* runtimeData;
 	Trace* trace; //all data about encoding
-	context z3_ctx;
+	EncodeCache* cache; //NULL unless traces share their formulas
+	std::auto_ptr<context> ownContext; //NULL if cache provides the context
+	context &z3_ctx; //*ownContext or the context of cache
 	solver z3_solver;
 	solver z3_taint_solver;
+	KQuery2Z3 kq; //shared by all formulas of this trace, caches sub-terms
+	SolverStrategy strategy;
 	FilterSymbolicExpr filter;
 	unsigned formulaNum;
 	unsigned solvingTimes;
+	double budgetCost; //seconds spent in solveQuery and PTS for this trace
+	bool retrying; //check_if solves the queries that ran out of time again
+	expr_vector baseAssumptions; //indicators of this trace in cache
+	expr_vector queryAssumptions; //literals of the constraints of the current branch query
+	vector<unsigned> queryIds; //ast ids of these constraints
+	map<unsigned, expr> queryConstraints;
+	vector<vector<unsigned> > unsatCores; //sorted ast ids of the cores found so far
+	Solver* kleeSolver; //solver chain of klee for the queries, NULL if z3 solves them
+	Z3ToKQuery toKQuery;
+	unsigned baseAssertionNum; //assertions of z3_solver before the current query
+	bool solvedByKlee; //the last query was solved by kleeSolver, its model is kleeModel
+	model kleeModel;
 
 public:
-	Encode(RuntimeDataManager* data) :
-			runtimeData(data), z3_solver(z3_ctx), z3_taint_solver(z3_ctx) {
-		trace = data->getCurrentTrace();
-		formulaNum = 0;
-		solvingTimes = 0;
-	}
+	Encode(RuntimeDataManager* data);
 	~Encode() {
 		runtimeData->allFormulaNum += formulaNum;
 		runtimeData->solvingTimes += solvingTimes;
@@ -58,6 +82,8 @@ public:
 
 	void PTS();
 
+	static const char* getStrategyName(SolverStrategy strategy);
+
 private:
 
 	////////////////////////////////modify this sagment at the end/////////////////////////
@@ -67,13 +93,22 @@ private:
 	vector<pair<Event*, expr> > ifFormula;
 	vector<pair<Event*, expr> > assertFormula;
 	vector<pair<Event*, expr> > rwFormula;
+	vector<unsigned> ifBrIndex; //index in trace->brEvent of each ifFormula
+	vector<pair<unsigned, expr> > implicitBrFormula; //brEvent index and formula of the br without two targets
+	vector<expr> orderFormula; //memory model, partial order and sync formulas, shared by all cones
+	vector<pair<string, expr> > dataFormula; //data formulas and their variable, sliced to the cone of a branch
 
-	void buildInitValueFormula(solver z3_solver_init);
-	void buildPathCondition(solver z3_solver_pc);
+	void buildInitValueFormula(solver z3_solver_init, vector<pair<string, expr> > *sliced = NULL);
+	void buildPathCondition(solver z3_solver_pc, vector<pair<string, expr> > *sliced = NULL);
 	void buildMemoryModelFormula(solver z3_solver_mm);
 	void buildPartialOrderFormula(solver z3_solver_po);
-	void buildReadWriteFormula(solver z3_solver_rw);
+	void buildReadWriteFormula(solver z3_solver_rw, vector<pair<string, expr> > *sliced = NULL);
 	void buildSynchronizeFormula(solver z3_solver_sync);
+	bool useLockChain(vector<LockPair*> &lockPairs);
+	void buildLockChainFormula(solver z3_solver_sync, string mutex, vector<LockPair*> &lockPairs,
+			map<Event*, vector<unsigned> > &clocks);
+	void computeForkJoinClock(map<Event*, vector<unsigned> > &clocks);
+	bool happensBefore(map<Event*, vector<unsigned> > &clocks, Event* one, Event* two);
 	void buildInitTaintFormula(solver z3_solver_it);
 	void buildTaintMatchFormula(solver z3_solver_tm);
 	void buildTaintProgatationFormula(solver z3_solver_tp);
@@ -81,18 +116,37 @@ private:
 
 	expr buildExprForConstantValue(Value *V, bool isLeft, string prefix);
 
+	solver makeSolver(SolverStrategy strategy);
+	check_result checkBase(); //check z3_solver under baseAssumptions
+	check_result solveQuery(unsigned timeout);
+	bool solveWithKlee(unsigned timeout, check_result &result);
+	void markQueryStart();
+	model getModel();
+	void addBeforeViolation(Event* event, expr condition, expr violation, vector<unsigned> &candidate, vector<expr> &selector);
+	check_result checkBranch(unsigned i, unsigned num, unsigned timeout);
+	void addQueryConstraint(expr constraint);
+	void computeBranchCone(unsigned i, std::set<std::string> &cone, vector<bool> &coneBranch);
+	solver buildConeSolver(std::set<std::string> &cone);
+	void clearQueryConstraints();
+	bool implyKnownCore();
+	void recordUnsatCore();
+	SolverStrategy selectSolverStrategy();
+	void benchmarkStrategies(string queryName);
+	void dumpQuery(string queryName, Event* event);
+
 private:
 	void markLatestWriteForGlobalVar();
 
 	map<string, Event*> latestWriteOneThread;
 	map<int, map<string, Event*> > allThreadLastWrite;
-	map<string, expr> eventNameInZ3; //int:eventid.add data in function buildMemoryModelFormula
+	vector<pair<Event*, expr> > eventOrderInZ3; //all non-virtual events and their order. add data in function buildMemoryModelFormula
 	z3::sort llvmTy_to_z3Ty(const Type *typ);
 
 	//key--local var, value--index..like ssa
 	expr makeExprsAnd(vector<expr> exprs);
 	expr makeExprsOr(vector<expr> exprs);
 	expr makeExprsSum(vector<expr> exprs);
+	void buildAtMostOne(solver z3_solver_amo, vector<expr> &exprs, string name);
 	expr enumerateOrder(Event *read, Event *write, Event *anotherWrite);
 	expr readFromWriteFormula(Event *read, Event *write, string var);
 	bool readFromInitFormula(Event * read, expr& ret);
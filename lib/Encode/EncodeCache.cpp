@@ -0,0 +1,56 @@
+//===-- EncodeCache.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "EncodeCache.h"
+
+#include <sstream>
+
+using namespace z3;
+
+namespace klee {
+
+	EncodeCache::EncodeCache(unsigned maxFormula) :
+			z3_solver(z3_ctx), maxFormula(maxFormula), strategy(-1) {
+		reusedFormulaNum = 0;
+		newFormulaNum = 0;
+	}
+
+	bool EncodeCache::isFull(unsigned formulas) {
+		//the shared solver only grows, start again once it is too large
+		return maxFormula && indicators.size() + formulas > maxFormula;
+	}
+
+	void EncodeCache::restart(const solver &fresh, int strategy) {
+		indicators.clear();
+		z3_solver = fresh;
+		this->strategy = strategy;
+	}
+
+	void EncodeCache::track(solver &base, expr_vector &assumptions) {
+		expr_vector assertions = base.assertions();
+		for (unsigned i = 0; i < assertions.size(); i++) {
+			expr constraint = assertions[i];
+			unsigned id = Z3_get_ast_id(z3_ctx, constraint);
+			std::map<unsigned, std::pair<expr, expr> >::iterator it = indicators.find(id);
+			if (it != indicators.end()) {
+				reusedFormulaNum++;
+				assumptions.push_back(it->second.second);
+				continue;
+			}
+			std::stringstream ss;
+			ss << "_F" << id;
+			expr indicator = z3_ctx.bool_const(ss.str().c_str());
+			z3_solver.add(implies(indicator, constraint));
+			indicators.insert(std::make_pair(id, std::make_pair(constraint, indicator)));
+			newFormulaNum++;
+			assumptions.push_back(indicator);
+		}
+	}
+
+}
@@ -0,0 +1,65 @@
+//===-- EncodeCache.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Formulas shared by the traces of one run.
+//
+// A child trace replays the prefix of its parent, so the events of the
+// prefix get the same eventName and most of their ordering constraints
+// are the same z3 terms as in the parent. All traces are encoded in one
+// context here and every constraint is asserted only once, guarded by an
+// indicator literal. A trace is solved under the indicators of its own
+// constraints, so a child only adds the constraints of its new suffix and
+// keeps what the solver learned on the parent.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LIB_ENCODE_ENCODECACHE_H_
+#define LIB_ENCODE_ENCODECACHE_H_
+
+#include <z3++.h>
+#include <map>
+
+namespace klee {
+
+class EncodeCache {
+private:
+	z3::context z3_ctx;
+	z3::solver z3_solver;
+	//id of the constraint ast -> (constraint, indicator)
+	//the constraint is kept alive so that its id is not reused
+	std::map<unsigned, std::pair<z3::expr, z3::expr> > indicators;
+	unsigned maxFormula;
+	int strategy; //SolverStrategy z3_solver was built with, -1 before the first trace
+
+public:
+	unsigned reusedFormulaNum;
+	unsigned newFormulaNum;
+
+	EncodeCache(unsigned maxFormula);
+	z3::context& getContext() {
+		return z3_ctx;
+	}
+	z3::solver& getSolver() {
+		return z3_solver;
+	}
+	int getStrategy() {
+		return strategy;
+	}
+	//adding this many formulas would exceed maxFormula
+	bool isFull(unsigned formulas);
+	//drop all formulas and go on with fresh, a solver of strategy
+	void restart(const z3::solver &fresh, int strategy);
+	//move the assertions of base into the shared solver and
+	//collect the indicators that switch them on
+	void track(z3::solver &base, z3::expr_vector &assumptions);
+};
+
+}
+
+#endif /* LIB_ENCODE_ENCODECACHE_H_ */
@@ -26,7 +26,7 @@ namespace klee {
 			threadId(threadId), eventId(eventId), eventName(eventName), inst(inst), name(varName), globalName(globalName), eventType(
 					eventType), latestWriteEventInSameThread(NULL), isGlobal(false), isEventRelatedToBranch(false), isConditionInst(false), brCondition(
 					false), isFunctionWithSourceCode(true), calledFunction(
-			NULL) {
+			NULL), spinCount(0) {
 		threadEventId = 0;
 	}
 
@@ -47,6 +47,9 @@ namespace klee {
 		if (isGlobal)
 			ss << " #globalName = " << globalName;
 		ss << "\n";
+		if (spinCount) {
+			ss << " #SpinCount = " << spinCount << "\n";
+		}
 		if (isConditionInst) {
 			ss << " #CondChoose = " << brCondition << "\n";
 		}
@@ -42,6 +42,7 @@ namespace klee {
 			bool brCondition; // Br's condition
 			bool isFunctionWithSourceCode; // only use by call, whether the called function is defined by user
 			llvm::Function* calledFunction; //set for called function. all callinst use it.@14.12.02
+			unsigned spinCount; //the busy-wait reads collapsed into this read, see PSOListener
 			std::vector<unsigned> vectorClock;
 			std::vector<ref<klee::Expr> > instParameter;
 			std::vector<ref<klee::Expr> > relatedSymbolicExpr;
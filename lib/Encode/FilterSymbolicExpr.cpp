@@ -6,6 +6,7 @@
 #include <llvm/IR/Constant.h>
 #include <llvm/IR/Instruction.h>
 #include <llvm/Support/Casting.h>
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <iterator>
@@ -458,6 +459,41 @@ namespace klee {
 		}
 	}
 
+	//all the variables the value of relatedSymbolicExpr depends on, transitively
+	void FilterSymbolicExpr::getConeOfInfluence(Trace* trace, std::set<std::string>* relatedSymbolicExpr,
+			std::set<std::string> &cone) {
+		std::map<std::string, std::set<std::string>*> &allRelatedSymbolicExpr = trace->allRelatedSymbolicExpr;
+		std::vector<std::string> worklist(relatedSymbolicExpr->begin(), relatedSymbolicExpr->end());
+		while (!worklist.empty()) {
+			std::string name = worklist.back();
+			worklist.pop_back();
+			if (!cone.insert(name).second) {
+				continue;
+			}
+			std::map<std::string, std::set<std::string>*>::iterator it = allRelatedSymbolicExpr.find(name);
+			if (it != allRelatedSymbolicExpr.end()) {
+				worklist.insert(worklist.end(), it->second->begin(), it->second->end());
+			}
+		}
+	}
+
+	bool FilterSymbolicExpr::isIntersect(std::set<std::string>* one, std::set<std::string>* two) {
+		if (one->size() > two->size()) {
+			std::swap(one, two);
+		}
+		for (std::set<std::string>::iterator it = one->begin(), ie = one->end(); it != ie; ++it) {
+			if (two->find(*it) != two->end()) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//undo fillterTrace with a smaller set, back to the variables of all branches
+	void FilterSymbolicExpr::restoreTrace(Trace* trace) {
+		fillterTrace(trace, allRelatedSymbolicExprSet);
+	}
+
 	void FilterSymbolicExpr::filterUselessByTaint(Trace* trace) {
 
 		std::set<std::string> &taintSymbolicExpr = trace->taintSymbolicExpr;
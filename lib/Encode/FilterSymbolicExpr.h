@@ -35,6 +35,9 @@ class FilterSymbolicExpr {
 		void filterUseless(Trace* trace);
 		void filterUselessByTaint(Trace* trace);
 		bool filterUselessWithSet(Trace* trace, std::set<std::string>* relatedSymbolicExpr);
+		static void getConeOfInfluence(Trace* trace, std::set<std::string>* relatedSymbolicExpr, std::set<std::string> &cone);
+		static bool isIntersect(std::set<std::string>* one, std::set<std::string>* two);
+		void restoreTrace(Trace* trace);
 
 };
 
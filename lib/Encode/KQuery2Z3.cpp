@@ -101,6 +101,17 @@ void KQuery2Z3::getZ3Expr() {
 }
 
 z3::expr KQuery2Z3::eachExprToZ3(ref<Expr> &ele) {
+	ExprHashMap<z3::expr> &cache = translated[ele->isFloat ? 1 : 0];
+	ExprHashMap<z3::expr>::iterator it = cache.find(ele);
+	if (it != cache.end()) {
+		return it->second;
+	}
+	z3::expr res = translateExpr(ele);
+	cache.insert(std::make_pair(ele, res));
+	return res;
+}
+
+z3::expr KQuery2Z3::translateExpr(ref<Expr> &ele) {
 	z3::expr res = z3_ctx.bool_val(true);
 
 	switch (ele->getKind()) {
@@ -891,3 +902,7 @@ z3::expr KQuery2Z3::getZ3Expr(ref<Expr>& e) {
 	z3::expr res = eachExprToZ3(e);
 	return res;
 }
+
+unsigned KQuery2Z3::getCacheSize() {
+	return translated[0].size() + translated[1].size();
+}
@@ -17,6 +17,7 @@
 #define KQUERY2Z3_H_
 
 #include "klee/Expr.h"
+#include "klee/util/ExprHashMap.h"
 #include "llvm/Support/DataTypes.h"
 #include "llvm/ADT/APFloat.h"
 
@@ -44,7 +45,12 @@ private:
 	//the parameter convert means convert a none float point
 	//to a float point.
 	z3::expr eachExprToZ3(ref<Expr> &ele);
+	z3::expr translateExpr(ref<Expr> &ele);
 	z3::context& z3_ctx;
+	//every sub-term is translated once per context and then shared.
+	//the same expr becomes a real or a bit-vector according to isFloat,
+	//so the translations are kept apart by that flag.
+	ExprHashMap<z3::expr> translated[2];
 	std::vector<z3::expr> vecZ3Expr;
 	std::vector<z3::expr> vecZ3ExprTest;
 	std::vector<ref<Expr> > kqueryExprTest;
@@ -60,6 +66,7 @@ public:
 	z3::expr getZ3Expr(ref<Expr>& e);
 	void printZ3AndKqueryExpr();
 	void printKquery();
+	unsigned getCacheSize();
 };
 
 } /*namespace end*/
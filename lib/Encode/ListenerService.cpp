@@ -22,26 +22,48 @@
 #include <llvm/IR/DataLayout.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Intrinsics.h>
+#include <llvm/Support/CommandLine.h>
 
 #include <stddef.h>
 #include <sys/time.h>
 #include <iterator>
 
+namespace {
+	llvm::cl::opt<bool> AnalyzeTrace("analyze-trace", llvm::cl::init(false),
+			llvm::cl::desc("Verify the asserts and negate the branches of each new trace, then find its taint with DTAM and PTS (default=off)"));
+}
+
 namespace klee {
 
 	ListenerService::ListenerService(Executor* executor) {
 		encode = NULL;
 		dtam = NULL;
 		cost = 0;
-
+		buildDispatchTable();
 	}
 
 	ListenerService::~ListenerService() {
 
 	}
 
+	void ListenerService::buildDispatchTable() {
+		beforeListeners.assign(llvm::Instruction::OtherOpsEnd, std::vector<BitcodeListener*>());
+		afterListeners.assign(llvm::Instruction::OtherOpsEnd, std::vector<BitcodeListener*>());
+		for (std::vector<BitcodeListener*>::iterator bit = bitcodeListeners.begin(), bie = bitcodeListeners.end(); bit != bie; ++bit) {
+			for (unsigned opcode = 0; opcode < llvm::Instruction::OtherOpsEnd; opcode++) {
+				if ((*bit)->listenBefore[opcode]) {
+					beforeListeners[opcode].push_back(*bit);
+				}
+				if ((*bit)->listenAfter[opcode]) {
+					afterListeners[opcode].push_back(*bit);
+				}
+			}
+		}
+	}
+
 	void ListenerService::pushListener(BitcodeListener* bitcodeListener) {
 		bitcodeListeners.push_back(bitcodeListener);
+		buildDispatchTable();
 	}
 
 	void ListenerService::removeListener(BitcodeListener* bitcodeListener) {
@@ -51,6 +73,7 @@ namespace klee {
 				break;
 			}
 		}
+		buildDispatchTable();
 	}
 
 	void ListenerService::removeListener(BitcodeListener::listenerKind kind) {
@@ -60,10 +83,12 @@ namespace klee {
 				break;
 			}
 		}
+		buildDispatchTable();
 	}
 
 	void ListenerService::popListener() {
 		bitcodeListeners.pop_back();
+		buildDispatchTable();
 	}
 
 	RuntimeDataManager* ListenerService::getRuntimeDataManager() {
@@ -88,18 +113,40 @@ namespace klee {
 //		llvm::errs() << " before : " << "prefix : " << executor->prefix->isFinished() << "\n";
 #endif
 
-		for (std::vector<BitcodeListener*>::iterator bit = bitcodeListeners.begin(), bie = bitcodeListeners.end(); bit != bie; ++bit) {
+		std::vector<BitcodeListener*> &listeners = beforeListeners[ki->inst->getOpcode()];
+		if (listeners.empty()) {
+			recordEvent(executor, state, ki);
+			return;
+		}
+		for (std::vector<BitcodeListener*>::iterator bit = listeners.begin(), bie = listeners.end(); bit != bie; ++bit) {
 
 			(*bit)->beforeExecuteInstruction(state, ki);
 
 		}
 	}
 
+	//every instruction is an event of the trace, prefixes are replayed event by event.
+	//the listener of an opcode records its events, the others only need a plain one
+	void ListenerService::recordEvent(Executor* executor, ExecutionState &state, KInstruction *ki) {
+		Trace* trace = rdManager.getCurrentTrace();
+		unsigned threadId = state.currentThread->threadId;
+		Event* item;
+		// filter the instruction linked by klee force-import such as klee_div_zero_check
+		if (executor->kmodule->internalFunctions.find(ki->inst->getParent()->getParent()) == executor->kmodule->internalFunctions.end()) {
+			item = trace->createEvent(threadId, ki, Event::NORMAL);
+		} else {
+			item = trace->createEvent(threadId, ki, Event::IGNORE);
+		}
+		trace->insertEvent(item, threadId);
+		trace->insertPath(item);
+	}
+
 	void ListenerService::afterExecuteInstruction(Executor* executor, ExecutionState &state, KInstruction *ki) {
 
 //		llvm::errs() << " after : " << "\n";
 
-		for (std::vector<BitcodeListener*>::iterator bit = bitcodeListeners.begin(), bie = bitcodeListeners.end(); bit != bie; ++bit) {
+		std::vector<BitcodeListener*> &listeners = afterListeners[ki->inst->getOpcode()];
+		for (std::vector<BitcodeListener*>::iterator bit = listeners.begin(), bie = listeners.end(); bit != bie; ++bit) {
 
 			(*bit)->afterExecuteInstruction(state, ki);
 
@@ -178,38 +225,43 @@ namespace klee {
 //			}
 //			rdManager.allGlobal += allGlobal;
 
-//			gettimeofday(&finish, NULL);
-//			cost = (double) (finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
-//			rdManager.runningCost += cost;
-//			rdManager.allDTAMSerialCost.push_back(cost);
-//
-//			gettimeofday(&start, NULL);
-//			encode = new Encode(&rdManager);
-//			encode->buildifAndassert();
-//			if (encode->verify()) {
-//				encode->check_if();
-//			}
-//			gettimeofday(&finish, NULL);
-//			cost = (double) (finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
-//			rdManager.solvingCost += cost;
-
-//			gettimeofday(&start, NULL);
-//			dtam = new DTAM(&rdManager);
-//			dtam->dtam();
-//			gettimeofday(&finish, NULL);
-//			cost = (double) (finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
-//			rdManager.DTAMCost += cost;
-//			rdManager.allDTAMCost.push_back(cost);
-//
-//			gettimeofday(&start, NULL);
-//			encode->PTS();
-//			gettimeofday(&finish, NULL);
-//			cost = (double) (finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
-//			rdManager.PTSCost += cost;
-//			rdManager.allPTSCost.push_back(cost);
-
-//			delete encode;
-//			delete dtam;
+			gettimeofday(&finish, NULL);
+			cost = (double) (finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
+			rdManager.runningCost += cost;
+
+			if (AnalyzeTrace) {
+				rdManager.allDTAMSerialCost.push_back(cost);
+
+				gettimeofday(&start, NULL);
+				encode = new Encode(&rdManager);
+				encode->buildifAndassert();
+				if (encode->verify()) {
+					encode->check_if();
+				}
+				gettimeofday(&finish, NULL);
+				cost = (double) (finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
+				rdManager.solvingCost += cost;
+
+				gettimeofday(&start, NULL);
+				dtam = new DTAM(&rdManager);
+				dtam->dtam();
+				gettimeofday(&finish, NULL);
+				cost = (double) (finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
+				rdManager.DTAMCost += cost;
+				rdManager.allDTAMCost.push_back(cost);
+
+				gettimeofday(&start, NULL);
+				encode->PTS();
+				gettimeofday(&finish, NULL);
+				cost = (double) (finish.tv_sec * 1000000UL + finish.tv_usec - start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
+				rdManager.PTSCost += cost;
+				rdManager.allPTSCost.push_back(cost);
+
+				delete encode;
+				delete dtam;
+				encode = NULL;
+				dtam = NULL;
+			}
 
 		}
 
@@ -220,6 +272,7 @@ namespace klee {
 //			(*bit)->~BitcodeListener();
 			bitcodeListeners.pop_back();
 		}
+		buildDispatchTable();
 
 //		if (executor->executionNum >= 70) {
 //			executor->isFinished = true;
@@ -229,6 +282,11 @@ namespace klee {
 
 	void ListenerService::ContextSwitch(Executor* executor, ExecutionState &state) {
 
+		//only the instruction after an access to a global variable is a switch point
+		if (!state.isGlobal) {
+			return;
+		}
+
 //		llvm::errs() << "ContextSwitch\n";
 		Trace* trace = rdManager.getCurrentTrace();
 		std::vector<Event*> path = trace->path;
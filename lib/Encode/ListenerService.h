@@ -25,12 +25,18 @@ namespace klee {
 
 		private:
 			std::vector<BitcodeListener*> bitcodeListeners;
+			//bitcodeListeners by opcode, only those listening to it
+			std::vector<std::vector<BitcodeListener*> > beforeListeners;
+			std::vector<std::vector<BitcodeListener*> > afterListeners;
 			RuntimeDataManager rdManager;
 			Encode *encode;
 			DTAM *dtam;
 			struct timeval start, finish;
 			double cost;
 
+			void buildDispatchTable();
+			void recordEvent(Executor* executor, ExecutionState &state, KInstruction *ki);
+
 		public:
 			ListenerService(Executor* executor);
 			~ListenerService();
@@ -13,8 +13,11 @@
 #include "../Core/Executor.h"
 #include "../Core/ExternalDispatcher.h"
 #include "klee/Internal/Module/KModule.h"
+#include "klee/Internal/Module/InstructionInfoTable.h"
+#include "klee/Internal/Support/ErrorHandling.h"
 
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
@@ -31,12 +34,30 @@
 using namespace std;
 using namespace llvm;
 
+namespace {
+	cl::opt<unsigned> SpinThreshold("spin-threshold", cl::init(8),
+			cl::desc("Rereads of a global variable that only decide branches, without a store in between, after which a thread is busy waiting: "
+					"it yields and the further reads are collapsed (0=off, default=8)"));
+}
+
 namespace klee {
 
 	PSOListener::PSOListener(Executor* executor, RuntimeDataManager* rdManager) :
 			BitcodeListener(rdManager), executor(executor), currentEvent(NULL) {
 		// TODO Auto-generated constructor stub
 		kind = PSOListenerKind;
+		//every instruction is an event, the plain ones are recorded by ListenerService.
+		//only calls are handled afterwards
+		listenNone();
+		listenBeforeOpcode(Instruction::Call);
+		listenBeforeOpcode(Instruction::GetElementPtr);
+		listenBeforeOpcode(Instruction::Br);
+		listenBeforeOpcode(Instruction::Switch);
+		listenBeforeOpcode(Instruction::Load);
+		listenBeforeOpcode(Instruction::Store);
+		listenBeforeOpcode(Instruction::AtomicRMW);
+		listenBeforeOpcode(Instruction::AtomicCmpXchg);
+		listenAfterOpcode(Instruction::Call);
 	}
 
 	PSOListener::~PSOListener() {
@@ -96,7 +117,7 @@ namespace klee {
 				Value *fp = cs.getCalledValue();
 				Function *f = executor->getTargetFunction(fp, state);
 				if (!f) {
-					ref<Expr> expr = executor->eval(ki, 0, state).value;
+					ref<Expr> expr = executor->eval(ki, 0, state).getValue();
 					ConstantExpr* constExpr = dyn_cast<ConstantExpr>(expr);
 					uint64_t functionPtr = constExpr->getZExtValue();
 					f = (Function*) functionPtr;
@@ -106,6 +127,10 @@ namespace klee {
 						&& kmodule->internalFunctions.find(f) == kmodule->internalFunctions.end()) {
 					item->isFunctionWithSourceCode = false;
 				}
+				if (!item->isFunctionWithSourceCode) {
+					//a synchronization or an external call may change what is read next
+					spinRecord.clear();
+				}
 //		llvm::errs()<<"isFunctionWithSourceCode : "<<item->isFunctionWithSourceCode<<"\n";
 
 				//by hy
@@ -114,13 +139,13 @@ namespace klee {
 					unsigned numArgs = cs.arg_size();
 					item->instParameter.reserve(numArgs);
 					for (unsigned j = 0; j < numArgs; ++j) {
-						item->instParameter.push_back(executor->eval(ki, j + 1, state).value);
+						item->instParameter.push_back(executor->eval(ki, j + 1, state).getValue());
 					}
 				}
 
 //		llvm::errs()<<"call name : "<< f->getName().str().c_str() <<"\n";
 				if (f->getName().str() == "pthread_create") {
-					ref<Expr> pthreadAddress = executor->eval(ki, 1, state).value;
+					ref<Expr> pthreadAddress = executor->eval(ki, 1, state).getValue();
 					ObjectPair pthreadop;
 					bool success = executor->getMemoryObject(pthreadop, state, state.currentStack->addressSpace, pthreadAddress);
 					if (success) {
@@ -131,7 +156,7 @@ namespace klee {
 						if (executor->isGlobalMO(pthreadmo)) {
 							item->isGlobal = true;
 						}
-						string varName = createVarName(pthreadmo->id, key, item->isGlobal);
+						string varName = createVarName(pthreadmo, key, item->isGlobal);
 						string varFullName;
 						if (item->isGlobal) {
 							unsigned loadTime = getLoadTime(key);
@@ -143,7 +168,7 @@ namespace klee {
 				} else if (f->getName().str() == "pthread_join") {
 					CallInst* calli = dyn_cast<CallInst>(inst);
 					IntegerType* paramType = (IntegerType*) (calli->getArgOperand(0)->getType());
-					ref<Expr> param = executor->eval(ki, 1, state).value;
+					ref<Expr> param = executor->eval(ki, 1, state).getValue();
 					ConstantExpr* joinedThreadIdExpr = dyn_cast<ConstantExpr>(param);
 					uint64_t joinedThreadId = joinedThreadIdExpr->getZExtValue(paramType->getBitWidth());
 					trace->insertThreadCreateOrJoin(make_pair(item, joinedThreadId), false);
@@ -153,11 +178,11 @@ namespace klee {
 					ObjectPair op;
 					Event *lock;
 					bool success;
-					param = executor->eval(ki, 2, state).value;
+					param = executor->eval(ki, 2, state).getValue();
 					success = executor->getMemoryObject(op, state, state.currentStack->addressSpace, param);
 					if (success) {
 						const MemoryObject* mo = op.first;
-						string mutexName = createVarName(mo->id, param, executor->isGlobalMO(mo));
+						string mutexName = createVarName(mo, param, executor->isGlobalMO(mo));
 						lock = trace->createEvent(thread->threadId, ki, Event::VIRTUAL);
 						lock->calledFunction = f;
 						backVirtualEvents.push_back(lock);
@@ -166,61 +191,61 @@ namespace klee {
 					} else {
 						assert(0 && "mutex not exist");
 					}
-					param = executor->eval(ki, 1, state).value;
+					param = executor->eval(ki, 1, state).getValue();
 					success = executor->getMemoryObject(op, state, state.currentStack->addressSpace, param);
 					if (success) {
 						const MemoryObject* mo = op.first;
-						string condName = createVarName(mo->id, param, executor->isGlobalMO(mo));
+						string condName = createVarName(mo, param, executor->isGlobalMO(mo));
 						trace->insertWait(condName, item, lock);
 					} else {
 						assert(0 && "cond not exist");
 					}
 				} else if (f->getName().str() == "pthread_cond_signal") {
-					ref<Expr> param = executor->eval(ki, 1, state).value;
+					ref<Expr> param = executor->eval(ki, 1, state).getValue();
 					ObjectPair op;
 					bool success = executor->getMemoryObject(op, state, state.currentStack->addressSpace, param);
 					if (success) {
 						const MemoryObject* mo = op.first;
-						string condName = createVarName(mo->id, param, executor->isGlobalMO(mo));
+						string condName = createVarName(mo, param, executor->isGlobalMO(mo));
 						trace->insertSignal(condName, item);
 					} else {
 						assert(0 && "cond not exist");
 					}
 				} else if (f->getName().str() == "pthread_cond_broadcast") {
-					ref<Expr> param = executor->eval(ki, 1, state).value;
+					ref<Expr> param = executor->eval(ki, 1, state).getValue();
 					ObjectPair op;
 					bool success = executor->getMemoryObject(op, state, state.currentStack->addressSpace, param);
 					if (success) {
 						const MemoryObject* mo = op.first;
-						string condName = createVarName(mo->id, param, executor->isGlobalMO(mo));
+						string condName = createVarName(mo, param, executor->isGlobalMO(mo));
 						trace->insertSignal(condName, item);
 					} else {
 						assert(0 && "cond not exist");
 					}
 				} else if (f->getName().str() == "pthread_mutex_lock") {
-					ref<Expr> param = executor->eval(ki, 1, state).value;
+					ref<Expr> param = executor->eval(ki, 1, state).getValue();
 					ObjectPair op;
 					bool success = executor->getMemoryObject(op, state, state.currentStack->addressSpace, param);
 					if (success) {
 						const MemoryObject* mo = op.first;
-						string mutexName = createVarName(mo->id, param, executor->isGlobalMO(mo));
+						string mutexName = createVarName(mo, param, executor->isGlobalMO(mo));
 						trace->insertLockOrUnlock(thread->threadId, mutexName, item, true);
 					} else {
 						assert(0 && "mutex not exist");
 					}
 				} else if (f->getName().str() == "pthread_mutex_unlock") {
-					ref<Expr> param = executor->eval(ki, 1, state).value;
+					ref<Expr> param = executor->eval(ki, 1, state).getValue();
 					ObjectPair op;
 					bool success = executor->getMemoryObject(op, state, state.currentStack->addressSpace, param);
 					if (success) {
 						const MemoryObject* mo = op.first;
-						string mutexName = createVarName(mo->id, param, executor->isGlobalMO(mo));
+						string mutexName = createVarName(mo, param, executor->isGlobalMO(mo));
 						trace->insertLockOrUnlock(thread->threadId, mutexName, item, false);
 					} else {
 						assert(0 && "mutex not exist");
 					}
 				} else if (f->getName().str() == "pthread_barrier_wait") {
-					ref<Expr> param = executor->eval(ki, 1, state).value;
+					ref<Expr> param = executor->eval(ki, 1, state).getValue();
 					ConstantExpr* barrierAddressExpr = dyn_cast<ConstantExpr>(param);
 					uint64_t barrierAddress = barrierAddressExpr->getZExtValue();
 					map<uint64_t, BarrierInfo*>::iterator bri = barrierRecord.find(barrierAddress);
@@ -239,7 +264,7 @@ namespace klee {
 						barrierInfo->addReleaseItem();
 					}
 				} else if (f->getName().str() == "pthread_barrier_init") {
-					ref<Expr> param = executor->eval(ki, 1, state).value;
+					ref<Expr> param = executor->eval(ki, 1, state).getValue();
 					ConstantExpr* barrierAddressExpr = dyn_cast<ConstantExpr>(param);
 					uint64_t barrierAddress = barrierAddressExpr->getZExtValue();
 					map<uint64_t, BarrierInfo*>::iterator bri = barrierRecord.find(barrierAddress);
@@ -251,11 +276,11 @@ namespace klee {
 						barrierInfo = bri->second;
 					}
 
-					param = executor->eval(ki, 3, state).value;
+					param = executor->eval(ki, 3, state).getValue();
 					ConstantExpr* countExpr = dyn_cast<ConstantExpr>(param);
 					barrierInfo->count = countExpr->getZExtValue();
 				} else if (f->getName() == "make_taint") {
-					ref<Expr> address = executor->eval(ki, 1, state).value;
+					ref<Expr> address = executor->eval(ki, 1, state).getValue();
 					ConstantExpr* realAddress = dyn_cast<ConstantExpr>(address);
 					if (realAddress) {
 						uint64_t key = realAddress->getZExtValue();
@@ -266,7 +291,7 @@ namespace klee {
 							if (executor->isGlobalMO(mo)) {
 								item->isGlobal = true;
 							}
-							string varName = createVarName(mo->id, key, item->isGlobal);
+							string varName = createVarName(mo, key, item->isGlobal);
 							string varFullName;
 							if (item->isGlobal) {
 								unsigned storeTime = getStoreTimeForTaint(key);
@@ -287,10 +312,6 @@ namespace klee {
 				break;
 			}
 
-			case Instruction::Ret: {
-				break;
-			}
-
 			case Instruction::GetElementPtr: {
 				//对于对数组解引用的GetElementPtr，获取其所有元素的地址，存放在Event中
 				//目前只处理一维数组,多维数组及指针数组赞不考虑，该处理函数存在问题
@@ -298,7 +319,7 @@ namespace klee {
 				KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
 				for (std::vector<std::pair<unsigned, uint64_t> >::iterator it = kgepi->indices.begin(), ie = kgepi->indices.end(); it != ie;
 						++it) {
-					ref<Expr> index = executor->eval(ki, it->first, state).value;
+					ref<Expr> index = executor->eval(ki, it->first, state).getValue();
 //			llvm::errs() << "kgepi->index : " << index << "\n";
 					item->instParameter.push_back(index);
 				}
@@ -313,26 +334,41 @@ namespace klee {
 				BranchInst *bi = dyn_cast<BranchInst>(inst);
 				if (!bi->isUnconditional()) {
 					item->isConditionInst = true;
-					ref<Expr> param = executor->eval(ki, 0, state).value;
+					ref<Expr> param = executor->eval(ki, 0, state).getValue();
 					ConstantExpr* condition = dyn_cast<ConstantExpr>(param);
 					if (condition->isTrue()) {
 						item->brCondition = true;
 					} else {
 						item->brCondition = false;
 					}
+					//a condition over global reads is a branch Encode negates, or the condition of an assert
+					ref<Expr> symbolic = getSymbolicOperand(state, ki, 0);
+					if (item->eventType == Event::NORMAL && !isa<ConstantExpr>(symbolic)) {
+						if (isAssertFailure(bi->getSuccessor(1))) {
+							trace->assertEvent.push_back(item);
+							trace->assertSymbolicExpr.push_back(symbolic);
+						} else if (isAssertFailure(bi->getSuccessor(0))) {
+							trace->assertEvent.push_back(item);
+							trace->assertSymbolicExpr.push_back(Expr::createIsZero(symbolic));
+						} else {
+							trace->brEvent.push_back(item);
+							trace->brSymbolicExpr.push_back(item->brCondition ? symbolic : Expr::createIsZero(symbolic));
+						}
+					}
 				}
 				break;
 			}
 
 			case Instruction::Load: {
 				LoadInst* li = dyn_cast<LoadInst>(ki->inst);
+				symbolicValues.erase(make_pair(thread->threadId, (const Value*) inst));
 				if (li->getPointerOperand()->getName().equals("stdout") || li->getPointerOperand()->getName().equals("stderr")) {
 					item->eventType = Event::IGNORE;
-				} else {
-					ref<Expr> address = executor->eval(ki, 0, state).value;
+				} else if (ki->access != KInstruction::ThreadLocal) {
+					ref<Expr> address = executor->eval(ki, 0, state).getValue();
 					ObjectPair op;
 #if DEBUG_RUNTIME
-					ref<Expr> addressCurrent = executor->evalCurrent(ki, 0, state).value;
+					ref<Expr> addressCurrent = executor->evalCurrent(ki, 0, state).getValue();
 					llvm::errs() << "address : " << address << " address Current : " << addressCurrent << "\n";
 					bool successCurrent = executor->getMemoryObject(op, state, state.currentThread->addressSpace, addressCurrent);
 					llvm::errs() << "successCurrent : " << successCurrent << "\n";
@@ -340,14 +376,26 @@ namespace klee {
 					ConstantExpr* realAddress = dyn_cast<ConstantExpr>(address);
 					if (realAddress) {
 						uint64_t key = realAddress->getZExtValue();
-						bool success = executor->getMemoryObject(op, state, state.currentStack->addressSpace, address);
-						if (success) {
-							const MemoryObject *mo = op.first;
-							if (executor->isGlobalMO(mo)) {
+						const MemoryAccess *access = executor->getMemoryAccess(state, ki, address);
+						if (access->success) {
+							const MemoryObject *mo = access->mo;
+							if (access->isGlobal && isSpinning(item, key)) {
+								//one more iteration of a busy-wait loop reads what its summary read,
+								//so it is left out of the encode and the thread lets the others run
+								item->eventType = Event::IGNORE;
+								if (!(executor->prefix && !executor->prefix->isFinished())) {
+									state.reSchedule();
+								}
+								break;
+							}
+							if (access->isGlobal) {
 								item->isGlobal = true;
-								state.isGlobal = true;
+								//no switch point inside a run of protected accesses, see LocksetPass
+								if (!(ki->lockFacts & KInstruction::NoSwitchAfter)) {
+									state.isGlobal = true;
+								}
 							}
-							string varName = createVarName(mo->id, key, item->isGlobal);
+							string varName = createVarName(mo, key, item->isGlobal);
 							string varFullName;
 							if (item->isGlobal) {
 								unsigned loadTime = getLoadTime(key);
@@ -362,6 +410,11 @@ namespace klee {
 							if (!inst->getType()->isPointerTy() && item->isGlobal) {
 #endif
 								trace->insertReadSet(varName, item);
+								if (inst->getType()->isIntegerTy() && !inst->getType()->isIntegerTy(1)) {
+									Expr::Width width = executor->getWidthForLLVMType(inst->getType());
+									symbolicValues[make_pair(thread->threadId, (const Value*) inst)] = Expr::createTempRead(
+											new Array(varFullName, Expr::getMinBytesForWidth(width)), width);
+								}
 							}
 							if (inst->getOperand(0)->getValueID() == Value::InstructionVal + Instruction::GetElementPtr) {
 
@@ -378,7 +431,9 @@ namespace klee {
 			}
 
 			case Instruction::Store: {
-				ref<Expr> value = executor->eval(ki, 0, state).value;
+				//an iteration that stores, even to a local, computes something and is not busy waiting
+				spinRecord.erase(item->threadId);
+				ref<Expr> value = executor->eval(ki, 0, state).getValue();
 				item->instParameter.push_back(value);
 				ConstantExpr* realValue = dyn_cast<ConstantExpr>(value);
 				if (realValue) {
@@ -390,48 +445,128 @@ namespace klee {
 						executor->createSpecialElement(state, valueTy, startAddress, false);
 					}
 				}
-//				llvm::errs() << "PSO Store\n";
-				ref<Expr> address = executor->eval(ki, 1, state).value;
-				ConstantExpr* realAddress = dyn_cast<ConstantExpr>(address);
-//				llvm::errs() << "address : ";
-//				address->dump();
-				if (realAddress) {
-					uint64_t key = realAddress->getZExtValue();
-//					llvm::errs() << "key : " << key << "\n";
-					ObjectPair op;
-					bool success = executor->getMemoryObject(op, state, state.currentStack->addressSpace, address);
-					if (success) {
-						const MemoryObject *mo = op.first;
-						if (executor->isGlobalMO(mo)) {
-							item->isGlobal = true;
-							state.isGlobal = true;
-						}
-						string varName = createVarName(mo->id, key, item->isGlobal);
-						string varFullName;
-						if (item->isGlobal) {
-							unsigned storeTime = getStoreTime(key);
-							varFullName = createGlobalVarFullName(varName, storeTime, true);
-						}
-						item->globalName = varFullName;
-						item->name = varName;
+				//a thread-local address is never a global variable, see SharedAccessPass
+				if (ki->access != KInstruction::ThreadLocal) {
+//					llvm::errs() << "PSO Store\n";
+					ref<Expr> address = executor->eval(ki, 1, state).getValue();
+					ConstantExpr* realAddress = dyn_cast<ConstantExpr>(address);
+//					llvm::errs() << "address : ";
+//					address->dump();
+					if (realAddress) {
+						uint64_t key = realAddress->getZExtValue();
+//						llvm::errs() << "key : " << key << "\n";
+						const MemoryAccess *access = executor->getMemoryAccess(state, ki, address);
+						if (access->success) {
+							const MemoryObject *mo = access->mo;
+							if (access->isGlobal) {
+								item->isGlobal = true;
+								//no switch point inside a run of protected accesses, see LocksetPass
+								if (!(ki->lockFacts & KInstruction::NoSwitchAfter)) {
+									state.isGlobal = true;
+								}
+								//a write ends every busy-wait loop
+								spinRecord.clear();
+							}
+							string varName = createVarName(mo, key, item->isGlobal);
+							string varFullName;
+							if (item->isGlobal) {
+								unsigned storeTime = getStoreTime(key);
+								varFullName = createGlobalVarFullName(varName, storeTime, true);
+							}
+							item->globalName = varFullName;
+							item->name = varName;
 #if PTR
-						if (item->isGlobal) {
+							if (item->isGlobal) {
 #else
-						if (!inst->getOperand(0)->getType()->isPointerTy() && item->isGlobal) {
+							if (!inst->getOperand(0)->getType()->isPointerTy() && item->isGlobal) {
 #endif
-							trace->insertWriteSet(varName, item);
+								trace->insertWriteSet(varName, item);
+								//the value written over the reads it is computed from, see the atomics below
+								Type* valueTy = inst->getOperand(0)->getType();
+								if (valueTy->isIntegerTy() && !valueTy->isIntegerTy(1)) {
+									Expr::Width width = executor->getWidthForLLVMType(valueTy);
+									ref<Expr> writeValue = Expr::createTempRead(new Array(varFullName, Expr::getMinBytesForWidth(width)),
+											width);
+									trace->storeSymbolicExpr.push_back(EqExpr::alloc(getSymbolicOperand(state, ki, 0), writeValue));
+								}
+							}
+						} else {
+							llvm::errs() << "Store address = " << realAddress->getZExtValue() << "\n";
+							assert(0 && "store resolve unsuccess");
 						}
 					} else {
-						llvm::errs() << "Store address = " << realAddress->getZExtValue() << "\n";
-						assert(0 && "store resolve unsuccess");
+						assert(0 && " address is not const");
 					}
-				} else {
+				}
+				break;
+			}
+			case Instruction::AtomicRMW:
+			case Instruction::AtomicCmpXchg: {
+				ref<Expr> address = executor->eval(ki, 0, state).getValue();
+				ConstantExpr* realAddress = dyn_cast<ConstantExpr>(address);
+				if (!realAddress) {
 					assert(0 && " address is not const");
 				}
+				uint64_t key = realAddress->getZExtValue();
+				const MemoryAccess *access = executor->getMemoryAccess(state, ki, address);
+				if (!access->success) {
+					llvm::errs() << "Atomic address = " << key << "\n";
+					assert(0 && "atomic resolve unsuccess");
+				}
+				if (!access->isGlobal) {
+					break;
+				}
+				Expr::Width width = executor->getWidthForLLVMType(inst->getType());
+				ref<Expr> old = executor->readExpr(state, state.currentStack->addressSpace, address, width);
+				//a failing compare and swap only rereads, a loop retrying it is busy waiting
+				bool isFailed = false;
+				if (inst->getOpcode() == Instruction::AtomicCmpXchg) {
+					ref<Expr> compare = executor->eval(ki, 1, state).getValue();
+					ConstantExpr* success = dyn_cast<ConstantExpr>(EqExpr::create(old, compare));
+					isFailed = success && success->isFalse();
+				}
+				if (isFailed && isSpinning(item, key)) {
+					item->eventType = Event::IGNORE;
+					if (!(executor->prefix && !executor->prefix->isFinished())) {
+						state.reSchedule();
+					}
+					break;
+				}
+				if (!isFailed) {
+					spinRecord.clear();
+				}
+				item->isGlobal = true;
+				state.isGlobal = true;
+
+				//the read is item, the write is a virtual event behind it with the same name,
+				//so that no event of another thread can be ordered between them
+				const MemoryObject *mo = access->mo;
+				string varName = createVarName(mo, key, true);
+				item->name = varName;
+				item->globalName = createGlobalVarFullName(varName, getLoadTime(key), false);
+				Event* write = new Event(thread->threadId, item->eventId, item->eventName, ki, varName,
+						createGlobalVarFullName(varName, getStoreTime(key), true), Event::VIRTUAL);
+				write->isGlobal = true;
+				backVirtualEvents.push_back(write);
+#if PTR
+				if (item->isGlobal) {
+#else
+				if (!inst->getType()->isPointerTy() && item->isGlobal) {
+#endif
+					trace->insertReadSet(varName, item);
+					trace->insertWriteSet(varName, write);
+					//the value written, over the value read. filterUseless moves it to the path condition
+					//when the variable is related to a branch. the other operands are taken at their value
+					//in this execution, like every value of this listener
+					unsigned size = Expr::getMinBytesForWidth(width);
+					ref<Expr> readValue = Expr::createTempRead(new Array(item->globalName, size), width);
+					ref<Expr> writeValue = Expr::createTempRead(new Array(write->globalName, size), width);
+					trace->storeSymbolicExpr.push_back(EqExpr::alloc(executor->getAtomicResult(ki, state, readValue), writeValue));
+				}
 				break;
 			}
 			case Instruction::Switch: {
-				ref<Expr> cond = executor->eval(ki, 0, state).value;
+				ref<Expr> cond = executor->eval(ki, 0, state).getValue();
 				item->instParameter.push_back(cond);
 				item->isConditionInst = true;
 				item->brCondition = true;
@@ -466,7 +601,7 @@ namespace klee {
 				Value *fp = cs.getCalledValue();
 				Function *f = executor->getTargetFunction(fp, state);
 				if (!f) {
-					ref<Expr> expr = executor->eval(ki, 0, state).value;
+					ref<Expr> expr = executor->eval(ki, 0, state).getValue();
 					ConstantExpr* constExpr = dyn_cast<ConstantExpr>(expr);
 					uint64_t functionPtr = constExpr->getZExtValue();
 					f = (Function*) functionPtr;
@@ -474,7 +609,7 @@ namespace klee {
 
 //		llvm::errs()<<"call name : "<< f->getName().str().c_str() <<"\n";
 				if (f->getName().str() == "pthread_create") {
-					ref<Expr> pthreadAddress = executor->eval(ki, 1, state).value;
+					ref<Expr> pthreadAddress = executor->eval(ki, 1, state).getValue();
 					Expr::Width type = executor->getWidthForLLVMType(inst->getType());
 					ref<Expr> pid = executor->readExpr(state, state.currentThread->stack->addressSpace, pthreadAddress, type);
 					ConstantExpr* pidConstant = dyn_cast<ConstantExpr>(pid);
@@ -484,12 +619,6 @@ namespace klee {
 				}
 				break;
 			}
-			case Instruction::Load: {
-				ref<Expr> value = executor->getDestCell(state, ki).value;
-//				llvm::errs() << "PSO load : " << value << "\n";
-				break;
-			}
-
 			default: {
 				break;
 			}
@@ -514,7 +643,7 @@ namespace klee {
 			if (startAddress % alignment != 0) {
 				startAddress = (startAddress / alignment + 1) * alignment;
 			}
-			string globalVariableName = createVarName(mo->id, startAddress, executor->isGlobalMO(mo));
+			string globalVariableName = createVarName(mo, startAddress, executor->isGlobalMO(mo));
 			trace->insertGlobalVariableInitializer(globalVariableName, initializer);
 //		llvm::errs() << "globalVariableName : " << globalVariableName << "    value : "
 //				<< executor->evalConstant(initializer) << "\n";
@@ -526,7 +655,7 @@ namespace klee {
 			if (startAddress % alignment != 0) {
 				startAddress = (startAddress / alignment + 1) * alignment;
 			}
-			string globalVariableName = createVarName(mo->id, startAddress, executor->isGlobalMO(mo));
+			string globalVariableName = createVarName(mo, startAddress, executor->isGlobalMO(mo));
 			trace->insertGlobalVariableInitializer(globalVariableName, initializer);
 //		llvm::errs() << "globalVariableName : " << globalVariableName << "    value : "
 //				<< executor->evalConstant(initializer) << "\n";
@@ -669,7 +798,7 @@ namespace klee {
 		Type* returnType = inst->getType();
 		Constant* result = NULL;
 		if (!f->getName().startswith("klee") && !executor->kmodule->functionMap[f] && !returnType->isVoidTy()) {
-			ref<Expr> returnValue = executor->getDestCell(state, ki).value;
+			ref<Expr> returnValue = executor->getDestCell(state, ki).getValue();
 			result = Transfer::expr2Constant(returnValue.get(), returnType);
 		}
 		return result;
@@ -682,7 +811,7 @@ namespace klee {
 		Function *f = currentEvent->calledFunction;
 		if (f->getName() == "strcpy") {
 
-//		ref<Expr> scrAddress = executor->eval(ki, 2, state.currentstack[thread->threadId]).value;
+//		ref<Expr> scrAddress = executor->eval(ki, 2, state.currentstack[thread->threadId]).getValue();
 //		ObjectPair scrop;
 //		//处理scr
 //		executor->getMemoryObject(scrop, state, scrAddress);
@@ -699,7 +828,7 @@ namespace klee {
 //			Constant* constant = Transfer::expr2Constant(ch.get(),
 //					Type::getInt8Ty(inst->getContext()));
 //			ConstantExpr* cexpr = dyn_cast<ConstantExpr>(ch.get());
-//			string name = createVarName(scrmo->id, scraddress + i,
+//			string name = createVarName(scrmo, scraddress + i,
 //					executor->isGlobalMO(scrmo));
 //			if (executor->isGlobalMO(scrmo)) {
 //				unsigned loadTime = getLoadTime(scraddress + i);
@@ -714,7 +843,7 @@ namespace klee {
 //				break;
 //			}
 //		}
-			ref<Expr> destAddress = executor->eval(ki, 1, state).value;
+			ref<Expr> destAddress = executor->eval(ki, 1, state).getValue();
 			ObjectPair destop;
 			//处理dest
 			executor->getMemoryObject(destop, state, state.currentStack->addressSpace, destAddress);
@@ -725,7 +854,7 @@ namespace klee {
 			for (unsigned i = 0; i < destmo->size - destaddress + destmo->address; i++) {
 				ref<Expr> ch = destos->read(i, 8);
 				ConstantExpr* cexpr = dyn_cast<ConstantExpr>(ch);
-				string name = createVarName(destmo->id, destmo->address +i, executor->isGlobalMO(destmo));
+				string name = createVarName(destmo, destmo->address +i, executor->isGlobalMO(destmo));
 				if (executor->isGlobalMO(destmo)) {
 					unsigned storeTime = getStoreTime(destaddress + i);
 
@@ -745,21 +874,21 @@ namespace klee {
 			}
 
 		} else if (f->getName() == "getrlimit") {
-			ref<Expr> address = executor->eval(ki, 2, state).value;
+			ref<Expr> address = executor->eval(ki, 2, state).getValue();
 			ObjectPair op;
 			Type* type = inst->getOperand(1)->getType()->getPointerElementType();
 			executor->getMemoryObject(op, state, state.currentStack->addressSpace, address);
 			uint64_t start = dyn_cast<ConstantExpr>(address)->getZExtValue();
 			analyzeInputValue(start, op, type);
 		} else if (f->getName() == "lstat") {
-			ref<Expr> address = executor->eval(ki, 2, state).value;
+			ref<Expr> address = executor->eval(ki, 2, state).getValue();
 			ObjectPair op;
 			Type* type = inst->getOperand(1)->getType()->getPointerElementType();
 			executor->getMemoryObject(op, state, state.currentStack->addressSpace, address);
 			uint64_t start = dyn_cast<ConstantExpr>(address)->getZExtValue();
 			analyzeInputValue(start, op, type);
 		} else if (f->getName() == "time") {
-			ref<Expr> address = executor->eval(ki, 1, state).value;
+			ref<Expr> address = executor->eval(ki, 1, state).getValue();
 			ObjectPair op;
 			Type* type = inst->getOperand(0)->getType()->getPointerElementType();
 			executor->getMemoryObject(op, state, state.currentStack->addressSpace, address);
@@ -791,7 +920,7 @@ namespace klee {
 					address = (address / alignment + 1) * alignment;
 				}
 				ref<Expr> value = os->read(address - mo->address, type->getPrimitiveSizeInBits());
-				string variableName = createVarName(mo->id, address, executor->isGlobalMO(mo));
+				string variableName = createVarName(mo, address, executor->isGlobalMO(mo));
 //		map<uint64_t, unsigned>::iterator index = storeRecord.find(address);
 				unsigned storeTime = getStoreTime(address);
 				address += type->getPrimitiveSizeInBits() / 8;
@@ -882,6 +1011,58 @@ namespace klee {
 		return storeTime;
 	}
 
+//whether value only decides conditional branches, through compares, casts and operations with constants
+	static bool decidesOnlyBranches(const Value *value) {
+		for (Value::const_use_iterator ui = value->use_begin(), ue = value->use_end(); ui != ue; ++ui) {
+			const User *u = *ui;
+			if (const BranchInst *bi = dyn_cast<BranchInst>(u)) {
+				if (bi->isConditional()) {
+					continue;
+				}
+				return false;
+			}
+			if (const BinaryOperator *bo = dyn_cast<BinaryOperator>(u)) {
+				if (!isa<Constant>(bo->getOperand(0)) && !isa<Constant>(bo->getOperand(1))) {
+					return false;
+				}
+			} else if (!isa<CmpInst>(u) && !isa<CastInst>(u)) {
+				return false;
+			}
+			if (!decidesOnlyBranches(u)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+//a thread which rereads a global variable at the same load more than SpinThreshold times,
+//while nobody writes or synchronizes and it stores nothing, not even to a local, is polling
+//it in a busy-wait loop. the value read must only decide the loop, so that the collapsed
+//reads could not have computed anything else
+	bool PSOListener::isSpinning(Event* item, uint64_t address) {
+		if (SpinThreshold == 0) {
+			return false;
+		}
+		SpinRead &read = spinRecord[item->threadId][make_pair(item->inst, address)];
+		if (read.times == 0) {
+			read.polling = decidesOnlyBranches(item->inst->inst);
+		}
+		if (read.times < SpinThreshold) {
+			read.times++;
+			read.summary = item;
+			return false;
+		}
+		if (!read.polling) {
+			return false;
+		}
+		if (read.summary->spinCount == 0) {
+			klee_warning_once(item->inst, "busy-wait loop at %s:%u, further reads are collapsed",
+					item->inst->info->file.c_str(), item->inst->info->line);
+		}
+		read.summary->spinCount++;
+		return true;
+	}
+
 //获取函数指针指向的Function
 	Function * PSOListener::getPointeredFunction(ExecutionState & state, KInstruction * ki) {
 		StackFrame* sf = &state.currentStack->realStack.back();
@@ -894,14 +1075,140 @@ namespace klee {
 		ref<Expr> result;
 		if (vnumber < 0) {
 			unsigned index = -vnumber - 2;
-			result = executor->kmodule->constantTable[index].value;
+			result = executor->kmodule->constantTable[index].getValue();
 		} else {
 			//llvm::errs() << "locals = " << sf->locals << " vnumber = " << vnumber << " function name = " << sf->kf->function->getName().str() << "\n";
-			result = sf->locals[vnumber].value;
+			result = sf->locals[vnumber].getValue();
 		}
 		ConstantExpr* addrExpr = dyn_cast<klee::ConstantExpr>(result);
 		uint64_t addr = addrExpr->getZExtValue();
 		return (Function*) addr;
 	}
 
+	KInstruction* PSOListener::getKInstruction(Instruction* inst) {
+		KFunction* kf = executor->kmodule->functionMap[inst->getParent()->getParent()];
+		for (unsigned i = kf->basicBlockEntry[inst->getParent()]; i < kf->numInstructions; i++) {
+			if (kf->instructions[i]->inst == inst) {
+				return kf->instructions[i];
+			}
+		}
+		return NULL;
+	}
+
+	//the result of a comparison, arithmetic or integer cast over the given operands, NULL for the others
+	static ref<Expr> computeSymbolic(Instruction* inst, const vector<ref<Expr> > &operands, Expr::Width width) {
+		if (ICmpInst* ci = dyn_cast<ICmpInst>(inst)) {
+			switch (ci->getPredicate()) {
+				case ICmpInst::ICMP_EQ:
+					return EqExpr::create(operands[0], operands[1]);
+				case ICmpInst::ICMP_NE:
+					return NeExpr::create(operands[0], operands[1]);
+				case ICmpInst::ICMP_UGT:
+					return UgtExpr::create(operands[0], operands[1]);
+				case ICmpInst::ICMP_UGE:
+					return UgeExpr::create(operands[0], operands[1]);
+				case ICmpInst::ICMP_ULT:
+					return UltExpr::create(operands[0], operands[1]);
+				case ICmpInst::ICMP_ULE:
+					return UleExpr::create(operands[0], operands[1]);
+				case ICmpInst::ICMP_SGT:
+					return SgtExpr::create(operands[0], operands[1]);
+				case ICmpInst::ICMP_SGE:
+					return SgeExpr::create(operands[0], operands[1]);
+				case ICmpInst::ICMP_SLT:
+					return SltExpr::create(operands[0], operands[1]);
+				case ICmpInst::ICMP_SLE:
+					return SleExpr::create(operands[0], operands[1]);
+				default:
+					return NULL;
+			}
+		}
+		switch (inst->getOpcode()) {
+			case Instruction::Add:
+				return AddExpr::create(operands[0], operands[1]);
+			case Instruction::Sub:
+				return SubExpr::create(operands[0], operands[1]);
+			case Instruction::Mul:
+				return MulExpr::create(operands[0], operands[1]);
+			case Instruction::UDiv:
+				return UDivExpr::create(operands[0], operands[1]);
+			case Instruction::SDiv:
+				return SDivExpr::create(operands[0], operands[1]);
+			case Instruction::URem:
+				return URemExpr::create(operands[0], operands[1]);
+			case Instruction::SRem:
+				return SRemExpr::create(operands[0], operands[1]);
+			case Instruction::And:
+				return AndExpr::create(operands[0], operands[1]);
+			case Instruction::Or:
+				return OrExpr::create(operands[0], operands[1]);
+			case Instruction::Xor:
+				return XorExpr::create(operands[0], operands[1]);
+			case Instruction::Shl:
+				return ShlExpr::create(operands[0], operands[1]);
+			case Instruction::LShr:
+				return LShrExpr::create(operands[0], operands[1]);
+			case Instruction::AShr:
+				return AShrExpr::create(operands[0], operands[1]);
+			case Instruction::ZExt:
+				return ZExtExpr::create(operands[0], width);
+			case Instruction::SExt:
+				return SExtExpr::create(operands[0], width);
+			case Instruction::Trunc:
+				return ExtractExpr::create(operands[0], 0, width);
+			default:
+				return NULL;
+		}
+	}
+
+	/*
+	 * operand index of ki over the reads of global variables it is computed from
+	 * in this function. a value that comes through memory, a phi or a call is
+	 * taken at its value in this execution, like the operands of an atomic.
+	 */
+	ref<Expr> PSOListener::getSymbolicOperand(ExecutionState& state, KInstruction* ki, unsigned index) {
+		ref<Expr> value = executor->eval(ki, index, state).getValue();
+		Instruction* inst = dyn_cast<Instruction>(ki->inst->getOperand(index));
+		if (!inst || inst->getParent()->getParent() != ki->inst->getParent()->getParent()) {
+			return value;
+		}
+		map<pair<unsigned, const Value*>, ref<Expr> >::iterator it = symbolicValues.find(
+				make_pair(state.currentThread->threadId, (const Value*) inst));
+		if (it != symbolicValues.end()) {
+			return it->second;
+		}
+		if (!isa<ICmpInst>(inst) && !isa<BinaryOperator>(inst) && !isa<CastInst>(inst)) {
+			return value;
+		}
+		KInstruction* def = getKInstruction(inst);
+		if (!def) {
+			return value;
+		}
+		//without a phi the operands of def can not lead back to it
+		vector<ref<Expr> > operands;
+		bool symbolic = false;
+		for (unsigned i = 0; i < inst->getNumOperands(); i++) {
+			operands.push_back(getSymbolicOperand(state, def, i));
+			symbolic = symbolic || !isa<ConstantExpr>(operands.back());
+		}
+		if (!symbolic) {
+			return value;
+		}
+		ref<Expr> result = computeSymbolic(inst, operands, executor->getWidthForLLVMType(inst->getType()));
+		return result.isNull() ? value : result;
+	}
+
+	//bb ends the program through a failed assert
+	bool PSOListener::isAssertFailure(BasicBlock* bb) {
+		for (BasicBlock::iterator it = bb->begin(), ie = bb->end(); it != ie; it++) {
+			if (CallInst* ci = dyn_cast<CallInst>(it)) {
+				Function* f = ci->getCalledFunction();
+				if (f && (f->getName() == "__assert_fail" || f->getName() == "__assert_rtn")) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
 }
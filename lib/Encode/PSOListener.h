@@ -61,6 +61,20 @@ namespace klee {
 			std::map<uint64_t, llvm::Type*> usedGlobalVariableRecord;
 			std::map<uint64_t, BarrierInfo*> barrierRecord;
 
+			//the global reads of each thread since its last store, to find busy-wait loops
+			struct SpinRead {
+				unsigned times;
+				bool polling; //the value read only decides branches
+				Event* summary; //the last read which is not collapsed
+				SpinRead() :
+						times(0), polling(false), summary(NULL) {
+				}
+			};
+			std::map<unsigned, std::map<std::pair<KInstruction*, uint64_t>, SpinRead> > spinRecord;
+			//by thread, the value of the last execution of each load of a global variable:
+			//a read of the array named by the globalName of its event
+			std::map<std::pair<unsigned, const llvm::Value*>, ref<Expr> > symbolicValues;
+
 		private:
 			void handleInitializer(llvm::Constant* initializer, MemoryObject* mo, uint64_t& startAddress);
 			void handleConstantExpr(llvm::ConstantExpr* expr);
@@ -73,35 +87,16 @@ namespace klee {
 			unsigned getStoreTime(uint64_t address);
 			unsigned getStoreTimeForTaint(uint64_t address);
 			llvm::Function* getPointeredFunction(ExecutionState& state, KInstruction* ki);
+			KInstruction* getKInstruction(llvm::Instruction* inst);
+			ref<Expr> getSymbolicOperand(ExecutionState& state, KInstruction* ki, unsigned index);
+			bool isAssertFailure(llvm::BasicBlock* bb);
+			bool isSpinning(Event* item, uint64_t address);
 
-			std::string createVarName(unsigned memoryId, ref<Expr> address, bool isGlobal) {
-				char signal;
-				ss.str("");
-				if (isGlobal) {
-					signal = 'G';
-				} else {
-					signal = 'L';
-				}
-				ss << signal;
-				ss << memoryId;
-				ss << '_';
-				ss << address;
-				return ss.str();
+			std::string createVarName(const MemoryObject *mo, ref<Expr> address, bool isGlobal) {
+				return Trace::createVarName(mo, address, isGlobal);
 			}
-			std::string createVarName(unsigned memoryId, uint64_t address, bool isGlobal) {
-				char signal;
-				ss.str("");
-				if (isGlobal) {
-					signal = 'G';
-				} else {
-					signal = 'L';
-				}
-				ss << signal;
-				ss << memoryId;
-				ss << '_';
-				ss << address;
-//				llvm::errs() << "create var name : " << ss.str() << "\n";
-				return ss.str();
+			std::string createVarName(const MemoryObject *mo, uint64_t address, bool isGlobal) {
+				return Trace::createVarName(mo, address, isGlobal);
 			}
 
 			std::string createGlobalVarFullName(std::string varName, unsigned time, bool isStore) {
@@ -6,6 +6,9 @@
  */
 
 #include "RuntimeDataManager.h"
+#include "DTAMCache.h"
+#include "EncodeCache.h"
+#include "klee/Solver.h"
 
 #include <llvm/Support/raw_ostream.h>
 #include <iterator>
@@ -20,7 +23,7 @@ using namespace llvm;
 namespace klee {
 
 	RuntimeDataManager::RuntimeDataManager() :
-			currentTrace(NULL) {
+			currentTrace(NULL), encodeCache(NULL), encodeSolver(NULL), dtamCache(NULL) {
 		traceList.reserve(20);
 
 		allFormulaNum = 0;
@@ -30,6 +33,12 @@ namespace klee {
 		satBranch = 0;
 		unSatBranchBySolve = 0;
 		unSatBranchByPreSolve = 0;
+		unknownBranch = 0;
+		unknownQuery = 0;
+		timeoutQuery = 0;
+		retryQuery = 0;
+		kleeQuery = 0;
+		kleeFallbackQuery = 0;
 
 		solvingCost = 0.0;
 		runningCost = 0.0;
@@ -42,6 +51,10 @@ namespace klee {
 		DTAMParallelCost = 0;
 		DTAMhybridCost = 0;
 		PTSCost = 0;
+		DTAMGraphCost = 0;
+		DTAMPropagateCost = 0;
+		PTSBuildCost = 0;
+		PTSSolveCost = 0;
 
 		system("rm -rf ./output_info");
 		system("mkdir ./output_info");
@@ -95,6 +108,23 @@ namespace klee {
 			ss << "unSatBranchByPreSolve:0" << "\n";
 		}
 
+		if (encodeCache) {
+			ss << "ReusedFormulaNum:" << encodeCache->reusedFormulaNum << "\n";
+			ss << "NewFormulaNum:" << encodeCache->newFormulaNum << "\n";
+			delete encodeCache;
+		}
+
+		ss << "ViolatedAssert:" << violatedAssert.size() << "\n";
+		ss << "unknownBranch:" << unknownBranch << "\n";
+		ss << "unknownQuery:" << unknownQuery << "\n";
+		ss << "timeoutQuery:" << timeoutQuery << "\n";
+		ss << "retryQuery:" << retryQuery << "\n";
+		if (encodeSolver) {
+			ss << "kleeQuery:" << kleeQuery << "\n";
+			ss << "kleeFallbackQuery:" << kleeFallbackQuery << "\n";
+			delete encodeSolver;
+		}
+
 		ss << "SolvingCost:" << solvingCost << "\n";
 		ss << "RunningCost:" << runningCost << "\n";
 
@@ -104,6 +134,15 @@ namespace klee {
 		ss << "DTAMParallelCost:" << DTAMParallelCost << "\n";
 		ss << "DTAMhybridCost:" << DTAMhybridCost << "\n";
 		ss << "PTSCost:" << PTSCost << "\n";
+		ss << "DTAMGraphCost:" << DTAMGraphCost << "\n";
+		ss << "DTAMPropagateCost:" << DTAMPropagateCost << "\n";
+		ss << "PTSBuildCost:" << PTSBuildCost << "\n";
+		ss << "PTSSolveCost:" << PTSSolveCost << "\n";
+		if (dtamCache) {
+			ss << "DTAMReusedPoint:" << dtamCache->reusedPointNum << "\n";
+			ss << "DTAMRecomputedPoint:" << dtamCache->recomputedPointNum << "\n";
+			delete dtamCache;
+		}
 
 		ss << "DTAMSerialMap:" << allDTAMSerialMap.size() << "\n";
 		ss << "DTAMParallelMap:" << allDTAMParallelMap.size() << "\n";
@@ -175,6 +214,20 @@ namespace klee {
 		scheduleSet.clear();
 	}
 
+	static string getAssertKey(const string &file, unsigned line) {
+		stringstream ss;
+		ss << file << ":" << line;
+		return ss.str();
+	}
+
+	bool RuntimeDataManager::isAssertViolated(const string &file, unsigned line) {
+		return violatedAssert.find(getAssertKey(file, line)) != violatedAssert.end();
+	}
+
+	void RuntimeDataManager::addViolatedAssert(const string &file, unsigned line) {
+		violatedAssert.insert(getAssertKey(file, line));
+	}
+
 	bool RuntimeDataManager::isCurrentTraceUntested() {
 		bool result = true;
 		for (set<Trace*>::iterator ti = testedTraceList.begin(), te = testedTraceList.end(); ti != te; ti++) {
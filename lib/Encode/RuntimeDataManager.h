@@ -21,6 +21,10 @@
 
 namespace klee {
 
+class EncodeCache;
+class DTAMCache;
+class Solver;
+
 class RuntimeDataManager {
 
 	private:
@@ -28,6 +32,7 @@ class RuntimeDataManager {
 		Trace* currentTrace; // trace associated with current execution
 		std::set<Trace*> testedTraceList; // traces which have been examined
 		std::list<Prefix*> scheduleSet; // prefixes which have not been examined
+		std::set<std::string> violatedAssert; // file:line of the asserts found violable
 
 	public:
 		unsigned allFormulaNum;
@@ -37,6 +42,16 @@ class RuntimeDataManager {
 		unsigned satBranch;
 		unsigned unSatBranchBySolve;
 		unsigned unSatBranchByPreSolve;
+		unsigned unknownBranch; // still unknown after all retries
+		unsigned unknownQuery;
+		unsigned timeoutQuery; // queries out of time or resources, each counted once
+		unsigned retryQuery; // solving attempts with a larger time limit
+		unsigned kleeQuery; // queries solved by encodeSolver
+		unsigned kleeFallbackQuery; // queries encodeSolver can not express, solved by z3
+
+		EncodeCache* encodeCache; // formulas shared by all traces, NULL if disabled
+		Solver* encodeSolver; // klee solver chain for Encode, NULL if z3 is used
+		DTAMCache* dtamCache; // taint of the last trace, NULL if disabled
 
 		double runningCost;
 		double solvingCost;
@@ -48,6 +63,10 @@ class RuntimeDataManager {
 		double DTAMParallelCost;
 		double DTAMhybridCost;
 		double PTSCost;
+		double DTAMGraphCost; // building the graph of DTAMParallel and DTAMhybrid
+		double DTAMPropagateCost;
+		double PTSBuildCost; // building the formula and the queries of PTS
+		double PTSSolveCost;
 
 
 
@@ -84,6 +103,8 @@ class RuntimeDataManager {
 		void printCurrentTrace(bool file);
 		Prefix* getNextPrefix();
 		void clearAllPrefix();
+		bool isAssertViolated(const std::string &file, unsigned line);
+		void addViolatedAssert(const std::string &file, unsigned line);
 		bool isCurrentTraceUntested();
 		void printAllPrefix(std::ostream &out);
 		void printAllTrace(std::ostream &out);
@@ -8,6 +8,8 @@
 #include "Trace.h"
 
 #include "Transfer.h"
+#include "../Core/Memory.h"
+#include "../Core/MemoryManager.h"
 #include "klee/Internal/Module/InstructionInfoTable.h"
 
 #include "llvm/IR/Attributes.h"
@@ -241,6 +243,26 @@ namespace klee {
 		return new Event(threadId, nextEventId, "E" + Transfer::uint64toString(nextEventId++), inst, "", "", eventType);
 	}
 
+	template<typename AddressTy>
+	static std::string buildVarName(const MemoryObject *mo, AddressTy address, bool isGlobal) {
+		std::stringstream ss;
+		ss << (isGlobal ? 'G' : 'L');
+		if (!MemoryManager::hasStableAddress(mo)) {
+			ss << mo->id;
+		}
+		ss << '_';
+		ss << address;
+		return ss.str();
+	}
+
+	std::string Trace::createVarName(const MemoryObject *mo, uint64_t address, bool isGlobal) {
+		return buildVarName(mo, address, isGlobal);
+	}
+
+	std::string Trace::createVarName(const MemoryObject *mo, ref<Expr> address, bool isGlobal) {
+		return buildVarName(mo, address, isGlobal);
+	}
+
 	void Trace::insertThreadCreateOrJoin(pair<Event*, uint64_t> item, bool isThreadCreate) {
 		if (isThreadCreate) {
 			createThreadPoint.insert(item);
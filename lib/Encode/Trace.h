@@ -24,6 +24,7 @@
 #include <vector>
 
 namespace klee {
+	class MemoryObject;
 
 	//added by xdzhang
 	struct Wait_Lock {
@@ -108,6 +109,10 @@ namespace klee {
 			void insertWriteSet(std::string name, Event* item);
 			Event* createEvent(unsigned threadId, KInstruction* inst, uint64_t address, bool isLoad, int time, Event::EventType eventType);
 			Event* createEvent(unsigned threadId, KInstruction* inst, Event::EventType eventType);
+			//name of the variable at address in mo, the id of mo is left out
+			//if the address is the same in every execution
+			static std::string createVarName(const MemoryObject *mo, uint64_t address, bool isGlobal);
+			static std::string createVarName(const MemoryObject *mo, ref<Expr> address, bool isGlobal);
 
 			void printAllEvent(llvm::raw_ostream& out);
 			void printThreadCreateAndJoin(llvm::raw_ostream& out);
@@ -0,0 +1,296 @@
+//===-- Z3ToKQuery.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Z3ToKQuery.h"
+
+#include "llvm/ADT/APInt.h"
+
+#include <z3_api.h>
+
+using namespace z3;
+
+namespace klee {
+
+	Z3ToKQuery::Z3ToKQuery(context& _z3_ctx) :
+			z3_ctx(_z3_ctx) {
+
+	}
+
+	bool Z3ToKQuery::getKQuery(const expr &e, ref<Expr> &ret) {
+		ret = translate(e);
+		return !ret.isNull();
+	}
+
+	ref<Expr> Z3ToKQuery::translate(const expr &e) {
+		unsigned id = Z3_get_ast_id(z3_ctx, e);
+		std::map<unsigned, std::pair<expr, ref<Expr> > >::iterator it = translated.find(id);
+		if (it != translated.end()) {
+			return it->second.second;
+		}
+		ref<Expr> ret;
+		if (e.is_app()) {
+			ret = translateApp(e);
+		}
+		translated.insert(std::make_pair(id, std::make_pair(e, ret)));
+		return ret;
+	}
+
+	ref<Expr> Z3ToKQuery::translateVariable(const expr &e) {
+		unsigned width;
+		if (e.is_bool()) {
+			width = 1;
+		} else if (e.is_int()) {
+			width = Expr::Int64;
+		} else if (e.is_bv() && e.get_sort().bv_size() <= Expr::Int64) {
+			width = e.get_sort().bv_size();
+		} else {
+			return ref<Expr>();
+		}
+		unsigned bytes = (width + 7) / 8;
+		std::string name = e.decl().name().str();
+		const Array *array;
+		std::map<std::string, const Array*>::iterator it = arrays.find(name);
+		if (it != arrays.end()) {
+			array = it->second;
+			if (array->size != bytes) {
+				return ref<Expr>();
+			}
+		} else {
+			array = arrayCache.CreateArray(name, bytes);
+			arrays.insert(std::make_pair(name, array));
+			variables.push_back(e);
+			objects.push_back(array);
+		}
+		//little endian, as Expr::createTempRead
+		UpdateList ul(array, 0);
+		ref<Expr> ret = ReadExpr::create(ul, ConstantExpr::alloc(0, Expr::Int32));
+		for (unsigned i = 1; i < bytes; i++) {
+			ret = ConcatExpr::create(ReadExpr::create(ul, ConstantExpr::alloc(i, Expr::Int32)), ret);
+		}
+		if (width != bytes * 8) {
+			ret = ExtractExpr::create(ret, 0, width);
+		}
+		return ret;
+	}
+
+	ref<Expr> Z3ToKQuery::translateNumeral(const expr &e) {
+		if (e.is_int()) {
+			int64_t value;
+			if (!Z3_get_numeral_int64(z3_ctx, e, &value)) {
+				return ref<Expr>();
+			}
+			return ConstantExpr::alloc((uint64_t) value, Expr::Int64);
+		}
+		if (!e.is_bv()) {
+			return ref<Expr>();
+		}
+		unsigned width = e.get_sort().bv_size();
+		if (width <= Expr::Int64) {
+			uint64_t value;
+			Z3_get_numeral_uint64(z3_ctx, e, &value);
+			return ConstantExpr::alloc(value, width);
+		}
+		return ConstantExpr::alloc(llvm::APInt(width, Z3_get_numeral_string(z3_ctx, e), 10));
+	}
+
+	ref<Expr> Z3ToKQuery::translateApp(const expr &e) {
+		func_decl decl = e.decl();
+		Z3_decl_kind kind = decl.decl_kind();
+		unsigned num = e.num_args();
+		switch (kind) {
+		case Z3_OP_UNINTERPRETED:
+			//functions are only used by the lock chain encoding
+			if (num) {
+				return ref<Expr>();
+			}
+			return translateVariable(e);
+		case Z3_OP_ANUM:
+		case Z3_OP_BNUM:
+			return translateNumeral(e);
+		case Z3_OP_TRUE:
+			return ConstantExpr::alloc(1, Expr::Bool);
+		case Z3_OP_FALSE:
+			return ConstantExpr::alloc(0, Expr::Bool);
+		default:
+			break;
+		}
+		if (!e.is_bool() && !e.is_int() && !e.is_bv()) {
+			return ref<Expr>();
+		}
+
+		std::vector<ref<Expr> > kids;
+		kids.reserve(num);
+		for (unsigned i = 0; i < num; i++) {
+			ref<Expr> kid = translate(e.arg(i));
+			if (kid.isNull()) {
+				return ref<Expr>();
+			}
+			kids.push_back(kid);
+		}
+		if (num == 0) {
+			return ref<Expr>();
+		}
+
+		ref<Expr> ret = kids[0];
+		switch (kind) {
+		case Z3_OP_AND:
+			for (unsigned i = 1; i < num; i++) {
+				ret = AndExpr::create(ret, kids[i]);
+			}
+			return ret;
+		case Z3_OP_OR:
+			for (unsigned i = 1; i < num; i++) {
+				ret = OrExpr::create(ret, kids[i]);
+			}
+			return ret;
+		case Z3_OP_NOT:
+			return Expr::createIsZero(kids[0]);
+		case Z3_OP_IMPLIES:
+			return Expr::createImplies(kids[0], kids[1]);
+		case Z3_OP_IFF:
+		case Z3_OP_EQ:
+			return EqExpr::create(kids[0], kids[1]);
+		case Z3_OP_XOR:
+			return XorExpr::create(kids[0], kids[1]);
+		case Z3_OP_DISTINCT:
+			ret = ConstantExpr::alloc(1, Expr::Bool);
+			for (unsigned i = 0; i < num; i++) {
+				for (unsigned j = i + 1; j < num; j++) {
+					ret = AndExpr::create(ret, Expr::createIsZero(EqExpr::create(kids[i], kids[j])));
+				}
+			}
+			return ret;
+		case Z3_OP_ITE:
+			return SelectExpr::create(kids[0], kids[1], kids[2]);
+
+		//integers are signed 64 bit vectors
+		case Z3_OP_LE:
+		case Z3_OP_SLEQ:
+			return SleExpr::create(kids[0], kids[1]);
+		case Z3_OP_LT:
+		case Z3_OP_SLT:
+			return SltExpr::create(kids[0], kids[1]);
+		case Z3_OP_GE:
+		case Z3_OP_SGEQ:
+			return SgeExpr::create(kids[0], kids[1]);
+		case Z3_OP_GT:
+		case Z3_OP_SGT:
+			return SgtExpr::create(kids[0], kids[1]);
+		case Z3_OP_ULEQ:
+			return UleExpr::create(kids[0], kids[1]);
+		case Z3_OP_ULT:
+			return UltExpr::create(kids[0], kids[1]);
+		case Z3_OP_UGEQ:
+			return UgeExpr::create(kids[0], kids[1]);
+		case Z3_OP_UGT:
+			return UgtExpr::create(kids[0], kids[1]);
+
+		case Z3_OP_ADD:
+		case Z3_OP_BADD:
+			for (unsigned i = 1; i < num; i++) {
+				ret = AddExpr::create(ret, kids[i]);
+			}
+			return ret;
+		case Z3_OP_SUB:
+		case Z3_OP_BSUB:
+			for (unsigned i = 1; i < num; i++) {
+				ret = SubExpr::create(ret, kids[i]);
+			}
+			return ret;
+		case Z3_OP_MUL:
+		case Z3_OP_BMUL:
+			for (unsigned i = 1; i < num; i++) {
+				ret = MulExpr::create(ret, kids[i]);
+			}
+			return ret;
+		case Z3_OP_UMINUS:
+		case Z3_OP_BNEG:
+			return SubExpr::create(ConstantExpr::alloc(0, kids[0]->getWidth()), kids[0]);
+		case Z3_OP_BUDIV:
+		case Z3_OP_BUDIV_I:
+			return UDivExpr::create(kids[0], kids[1]);
+		case Z3_OP_BSDIV:
+		case Z3_OP_BSDIV_I:
+			return SDivExpr::create(kids[0], kids[1]);
+		case Z3_OP_BUREM:
+		case Z3_OP_BUREM_I:
+			return URemExpr::create(kids[0], kids[1]);
+		case Z3_OP_BSREM:
+		case Z3_OP_BSREM_I:
+			return SRemExpr::create(kids[0], kids[1]);
+
+		case Z3_OP_BAND:
+			for (unsigned i = 1; i < num; i++) {
+				ret = AndExpr::create(ret, kids[i]);
+			}
+			return ret;
+		case Z3_OP_BOR:
+			for (unsigned i = 1; i < num; i++) {
+				ret = OrExpr::create(ret, kids[i]);
+			}
+			return ret;
+		case Z3_OP_BXOR:
+			for (unsigned i = 1; i < num; i++) {
+				ret = XorExpr::create(ret, kids[i]);
+			}
+			return ret;
+		case Z3_OP_BNOT:
+			return NotExpr::create(kids[0]);
+		case Z3_OP_BSHL:
+			return ShlExpr::create(kids[0], kids[1]);
+		case Z3_OP_BLSHR:
+			return LShrExpr::create(kids[0], kids[1]);
+		case Z3_OP_BASHR:
+			return AShrExpr::create(kids[0], kids[1]);
+		case Z3_OP_CONCAT:
+			for (unsigned i = 1; i < num; i++) {
+				ret = ConcatExpr::create(ret, kids[i]);
+			}
+			return ret;
+		case Z3_OP_EXTRACT: {
+			unsigned high = Z3_get_decl_int_parameter(z3_ctx, decl, 0);
+			unsigned low = Z3_get_decl_int_parameter(z3_ctx, decl, 1);
+			return ExtractExpr::create(kids[0], low, high - low + 1);
+		}
+		case Z3_OP_ZERO_EXT:
+			return ZExtExpr::create(kids[0], kids[0]->getWidth() + Z3_get_decl_int_parameter(z3_ctx, decl, 0));
+		case Z3_OP_SIGN_EXT:
+			return SExtExpr::create(kids[0], kids[0]->getWidth() + Z3_get_decl_int_parameter(z3_ctx, decl, 0));
+		default:
+			return ref<Expr>();
+		}
+	}
+
+	model Z3ToKQuery::getModel(std::vector<std::vector<unsigned char> > &values) {
+		model ret(z3_ctx, Z3_mk_model(z3_ctx));
+		for (unsigned i = 0; i < variables.size() && i < values.size(); i++) {
+			uint64_t value = 0;
+			for (unsigned j = 0; j < values[i].size() && j < 8; j++) {
+				value |= (uint64_t) values[i][j] << (8 * j);
+			}
+			expr var = variables[i];
+			Z3_ast interp;
+			if (var.is_bool()) {
+				interp = (value & 1) ? Z3_mk_true(z3_ctx) : Z3_mk_false(z3_ctx);
+			} else if (var.is_int()) {
+				interp = Z3_mk_int64(z3_ctx, (int64_t) value, var.get_sort());
+			} else {
+				unsigned width = var.get_sort().bv_size();
+				if (width < Expr::Int64) {
+					value &= ((uint64_t) 1 << width) - 1;
+				}
+				interp = Z3_mk_unsigned_int64(z3_ctx, value, var.get_sort());
+			}
+			expr keep(z3_ctx, interp);
+			Z3_add_const_interp(z3_ctx, ret, var.decl(), keep);
+		}
+		return ret;
+	}
+
+}
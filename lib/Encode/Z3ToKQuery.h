@@ -0,0 +1,68 @@
+//===-- Z3ToKQuery.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The inverse of KQuery2Z3: lowers the formulas built by Encode into
+// KLEE expressions, so that they can be solved by the solver chain of
+// KLEE (caching, independence, STP, ...).
+//
+// Every free constant becomes a symbolic array named after it. Order
+// variables are integers in z3, here they are 64 bit signed bit-vectors,
+// which keeps every model of the ordering constraints. Bit-vector data
+// keeps its width, booleans are one byte.
+//
+// Only the operators Encode produces are supported. A formula with
+// anything else (reals, uninterpreted functions, non linear integer
+// arithmetic) can not be lowered and is left to z3.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LIB_ENCODE_Z3TOKQUERY_H_
+#define LIB_ENCODE_Z3TOKQUERY_H_
+
+#include "klee/Expr.h"
+#include "klee/util/ArrayCache.h"
+
+#include <z3++.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace klee {
+
+class Z3ToKQuery {
+private:
+	z3::context& z3_ctx;
+	ArrayCache arrayCache;
+	//ast id -> lowered expr, a null ref marks a term that can not be lowered
+	//the z3 term is kept alive so that its id is not reused
+	std::map<unsigned, std::pair<z3::expr, ref<Expr> > > translated;
+	std::map<std::string, const Array*> arrays;
+	std::vector<z3::expr> variables; //free constants, in the order of objects
+	std::vector<const Array*> objects;
+
+	ref<Expr> translate(const z3::expr &e);
+	ref<Expr> translateApp(const z3::expr &e);
+	ref<Expr> translateVariable(const z3::expr &e);
+	ref<Expr> translateNumeral(const z3::expr &e);
+
+public:
+	Z3ToKQuery(z3::context& _z3_ctx);
+
+	//false if e uses an operator that has no KLEE counterpart
+	bool getKQuery(const z3::expr &e, ref<Expr> &ret);
+	const std::vector<const Array*>& getObjects() {
+		return objects;
+	}
+	//turn the values the solver computed for getObjects() into a z3 model
+	z3::model getModel(std::vector<std::vector<unsigned char> > &values);
+};
+
+}
+
+#endif /* LIB_ENCODE_Z3TOKQUERY_H_ */
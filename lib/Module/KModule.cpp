@@ -374,6 +374,10 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   }
   pm3.add(new IntrinsicCleanerPass(*targetData));
   pm3.add(new PhiCleanerPass());
+  SharedAccessPass *sharedAccess = new SharedAccessPass();
+  pm3.add(sharedAccess);
+  LocksetPass *lockset = new LocksetPass();
+  pm3.add(lockset);
   pm3.run(*module);
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 3)
   // For cleanliness see if we can discard any of the functions we
@@ -447,6 +451,17 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
     for (unsigned i=0; i<kf->numInstructions; ++i) {
       KInstruction *ki = kf->instructions[i];
       ki->info = &infos->getInfo(ki->inst);
+      if (sharedAccess->isSync(ki->inst))
+        ki->access = KInstruction::Sync;
+      else if (sharedAccess->isShared(ki->inst))
+        ki->access = KInstruction::MaybeShared;
+      else
+        ki->access = KInstruction::ThreadLocal;
+      ki->lockFacts = 0;
+      if (lockset->isReadingOwnWrite(ki->inst))
+        ki->lockFacts |= KInstruction::ReadsOwnWrite;
+      if (lockset->isNoSwitchAfter(ki->inst))
+        ki->lockFacts |= KInstruction::NoSwitchAfter;
     }
 
     functions.push_back(kf);
@@ -564,6 +579,13 @@ KFunction::KFunction(llvm::Function *_function,
 
       ki->inst = it;      
       ki->dest = registerMap[it];
+      if (isa<LoadInst>(it) || isa<StoreInst>(it) ||
+          isa<AtomicRMWInst>(it) || isa<AtomicCmpXchgInst>(it))
+        ki->resolutionCache = new ResolutionCache();
+      else
+        ki->resolutionCache = 0;
+      ki->access = KInstruction::MaybeShared;
+      ki->lockFacts = 0;
 
       if (isa<CallInst>(it) || isa<InvokeInst>(it)) {
         CallSite cs(it);
@@ -0,0 +1,333 @@
+//===-- Lockset.cpp -------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#include "klee/Config/Version.h"
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#else
+#include "llvm/Constants.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#endif
+#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/CFG.h"
+#else
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/CFG.h"
+#endif
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+using namespace llvm;
+
+namespace klee {
+
+char LocksetPass::ID;
+
+static const Function *getCallee(const Instruction *i) {
+  if (!isa<CallInst>(i) && !isa<InvokeInst>(i))
+    return 0;
+  ImmutableCallSite cs(i);
+  return dyn_cast<Function>(cs.getCalledValue()->stripPointerCasts());
+}
+
+/// The mutex i passes to the pthread function name, 0 if i is not such a
+/// call or the address of the mutex is not a constant.
+static const Value *getMutex(const Instruction *i, const char *name) {
+  const Function *f = getCallee(i);
+  if (!f || f->getName() != name)
+    return 0;
+  ImmutableCallSite cs(i);
+  unsigned index = f->getName() == "pthread_cond_wait" ? 1 : 0;
+  if (cs.arg_size() <= index)
+    return 0;
+  const Value *mutex = cs.getArgument(index)->stripPointerCasts();
+  return isa<Constant>(mutex) ? mutex : 0;
+}
+
+static const Value *getPointerOperand(const Instruction *i) {
+  if (const LoadInst *li = dyn_cast<LoadInst>(i))
+    return li->getPointerOperand();
+  if (const StoreInst *si = dyn_cast<StoreInst>(i))
+    return si->getPointerOperand();
+  return 0;
+}
+
+/// The global variable a constant address points into.
+static const GlobalVariable *getBaseGlobal(const Value *pointer) {
+  pointer = pointer->stripPointerCasts();
+  if (const GlobalVariable *gv = dyn_cast<GlobalVariable>(pointer))
+    return gv;
+  if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(pointer))
+    if (ce->getOpcode() == Instruction::GetElementPtr)
+      return dyn_cast<GlobalVariable>(ce->getOperand(0)->stripPointerCasts());
+  return 0;
+}
+
+/// True if the address v is only used as the address of loads and stores.
+static bool isOnlyAccessedDirectly(const Value *v) {
+  for (Value::const_use_iterator ui = v->use_begin(), ue = v->use_end();
+       ui != ue; ++ui) {
+    const User *u = *ui;
+    if (isa<LoadInst>(u))
+      continue;
+    if (const StoreInst *si = dyn_cast<StoreInst>(u)) {
+      if (si->getValueOperand() == v)
+        return false;
+      continue;
+    }
+    if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(u)) {
+      if ((ce->getOpcode() == Instruction::GetElementPtr ||
+           ce->getOpcode() == Instruction::BitCast) &&
+          isOnlyAccessedDirectly(ce))
+        continue;
+    }
+    return false;
+  }
+  return true;
+}
+
+static bool isStackAddress(const Value *pointer) {
+  for (;;) {
+    pointer = pointer->stripPointerCasts();
+    if (const GetElementPtrInst *gep = dyn_cast<GetElementPtrInst>(pointer))
+      pointer = gep->getPointerOperand();
+    else
+      return isa<AllocaInst>(pointer);
+  }
+}
+
+bool LocksetPass::mayRelease(const Instruction *i) {
+  if (!isa<CallInst>(i) && !isa<InvokeInst>(i))
+    return false;
+  const Function *f = getCallee(i);
+  if (!f)
+    return true; // an indirect call may call anything
+  return f->getName() == "pthread_mutex_unlock" ||
+         f->getName() == "pthread_cond_wait" ||
+         f->getName() == "pthread_exit" ||
+         releasing.count(f);
+}
+
+void LocksetPass::findReleasingFunctions(Module &M) {
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (Module::iterator f = M.begin(), fe = M.end(); f != fe; ++f) {
+      if (f->isDeclaration() || releasing.count(f))
+        continue;
+      bool release = false;
+      for (Function::iterator b = f->begin(), be = f->end();
+           b != be && !release; ++b)
+        for (BasicBlock::iterator i = b->begin(), ie = b->end();
+             i != ie && !release; ++i)
+          release = mayRelease(i);
+      if (release) {
+        releasing.insert(f);
+        changed = true;
+      }
+    }
+  }
+}
+
+const GlobalVariable *LocksetPass::getProtectedVariable(const Instruction *i) {
+  const Value *pointer = getPointerOperand(i);
+  if (!pointer)
+    return 0;
+  const GlobalVariable *gv = getBaseGlobal(pointer);
+  if (!gv)
+    return 0;
+  std::map<const GlobalVariable*, ValueSet>::iterator it = protection.find(gv);
+  if (it == protection.end() || it->second.empty())
+    return 0;
+  return gv;
+}
+
+/// True if the operation of i may be observed by, or depend on, another
+/// thread. Stack accesses are never switch points at runtime.
+bool LocksetPass::isVisible(const Instruction *i) {
+  if (const Value *pointer = getPointerOperand(i))
+    return !isStackAddress(pointer);
+  if (isa<CallInst>(i) || isa<InvokeInst>(i)) {
+    const Function *f = getCallee(i);
+    return !f || !f->isIntrinsic();
+  }
+  return isa<AtomicRMWInst>(i) || isa<AtomicCmpXchgInst>(i) ||
+         isa<FenceInst>(i) || isa<VAArgInst>(i);
+}
+
+void LocksetPass::transfer(Analysis analysis, const Instruction *i,
+                           ValueSet &state) {
+  if (analysis == HeldLocks) {
+    if (const Value *mutex = getMutex(i, "pthread_mutex_lock")) {
+      state.insert(mutex);
+    } else if (const Value *mutex = getMutex(i, "pthread_mutex_unlock")) {
+      state.erase(mutex);
+    } else if (getMutex(i, "pthread_cond_wait")) {
+      // the mutex is held again when the wait returns
+    } else if (mayRelease(i)) {
+      state.clear();
+    }
+  } else {
+    if (isa<StoreInst>(i) && getProtectedVariable(i))
+      state.insert(getPointerOperand(i)->stripPointerCasts());
+    else if (mayRelease(i))
+      state.clear();
+  }
+}
+
+/// Forward must analysis of f: the state before a block is the
+/// intersection of the states after its predecessors, the entry starts
+/// empty. Once it is stable, the results at the loads and stores are
+/// recorded.
+void LocksetPass::solve(Function &f, Analysis analysis) {
+  std::map<const BasicBlock*, ValueSet> out;
+  for (bool record = false; ; ) {
+    bool changed = false;
+    for (Function::iterator b = f.begin(), be = f.end(); b != be; ++b) {
+      ValueSet state;
+      bool reached = b == f.begin();
+      for (pred_iterator pi = pred_begin(b), pe = pred_end(b); pi != pe; ++pi) {
+        std::map<const BasicBlock*, ValueSet>::iterator it = out.find(*pi);
+        if (it == out.end())
+          continue;
+        if (!reached) {
+          state = it->second;
+          reached = true;
+        } else {
+          ValueSet meet;
+          std::set_intersection(state.begin(), state.end(),
+                                it->second.begin(), it->second.end(),
+                                std::inserter(meet, meet.begin()));
+          state.swap(meet);
+        }
+      }
+      if (!reached)
+        continue;
+      for (BasicBlock::iterator i = b->begin(), ie = b->end(); i != ie; ++i) {
+        if (record && getPointerOperand(i)) {
+          if (analysis == HeldLocks) {
+            heldLocks[i] = state;
+          } else if (isa<LoadInst>(i) && getProtectedVariable(i) &&
+                     state.count(getPointerOperand(i)->stripPointerCasts())) {
+            readsOwnWrite.insert(i);
+          }
+        }
+        transfer(analysis, i, state);
+      }
+      std::map<const BasicBlock*, ValueSet>::iterator it = out.find(b);
+      if (it == out.end()) {
+        out.insert(std::make_pair(b, state));
+        changed = true;
+      } else if (it->second != state) {
+        it->second.swap(state);
+        changed = true;
+      }
+    }
+    if (record)
+      break;
+    if (!changed)
+      record = true;
+  }
+}
+
+/// Backward analysis of f: after an access of a protected variable, is the
+/// next visible operation on every path the access of a protected variable?
+/// Between the two only thread-local code runs, and no other thread can
+/// touch the second variable, so a switch after the first is equivalent to
+/// a switch after the second.
+void LocksetPass::findSwitchPoints(Function &f) {
+  std::map<const BasicBlock*, bool> in;
+  for (Function::iterator b = f.begin(), be = f.end(); b != be; ++b)
+    in[b] = true;
+  for (bool record = false; ; ) {
+    bool changed = false;
+    for (Function::iterator b = f.begin(), be = f.end(); b != be; ++b) {
+      const TerminatorInst *t = b->getTerminator();
+      bool next = t->getNumSuccessors() != 0;
+      for (unsigned s = 0, e = t->getNumSuccessors(); s != e; ++s)
+        next = next && in[t->getSuccessor(s)];
+      for (BasicBlock::iterator i = b->end(), ie = b->begin(); i != ie; ) {
+        --i;
+        if (getProtectedVariable(i)) {
+          if (record && next)
+            noSwitchAfter.insert(i);
+          next = true;
+        } else if (isVisible(i)) {
+          next = false;
+        }
+      }
+      if (in[b] != next) {
+        in[b] = next;
+        changed = true;
+      }
+    }
+    if (record)
+      break;
+    if (!changed)
+      record = true;
+  }
+}
+
+bool LocksetPass::runOnModule(Module &M) {
+  releasing.clear();
+  heldLocks.clear();
+  protection.clear();
+  readsOwnWrite.clear();
+  noSwitchAfter.clear();
+
+  findReleasingFunctions(M);
+  for (Module::iterator f = M.begin(), fe = M.end(); f != fe; ++f)
+    if (!f->isDeclaration())
+      solve(*f, HeldLocks);
+
+  // The mutexes common to all accesses of each variable.
+  std::map<const GlobalVariable*, bool> direct;
+  for (std::map<const Instruction*, ValueSet>::iterator it = heldLocks.begin(),
+         ie = heldLocks.end(); it != ie; ++it) {
+    const GlobalVariable *gv = getBaseGlobal(getPointerOperand(it->first));
+    if (!gv)
+      continue;
+    std::map<const GlobalVariable*, bool>::iterator d = direct.find(gv);
+    if (d == direct.end())
+      d = direct.insert(std::make_pair(gv, !gv->isDeclaration() &&
+                                       isOnlyAccessedDirectly(gv))).first;
+    if (!d->second)
+      continue;
+    std::map<const GlobalVariable*, ValueSet>::iterator p = protection.find(gv);
+    if (p == protection.end()) {
+      protection.insert(std::make_pair(gv, it->second));
+    } else {
+      ValueSet meet;
+      std::set_intersection(p->second.begin(), p->second.end(),
+                            it->second.begin(), it->second.end(),
+                            std::inserter(meet, meet.begin()));
+      p->second.swap(meet);
+    }
+  }
+
+  for (Module::iterator f = M.begin(), fe = M.end(); f != fe; ++f) {
+    if (f->isDeclaration())
+      continue;
+    solve(*f, WrittenAddresses);
+    findSwitchPoints(*f);
+  }
+  return false;
+}
+
+}
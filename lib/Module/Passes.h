@@ -24,8 +24,12 @@
 #include "llvm/Pass.h"
 #include "llvm/CodeGen/IntrinsicLowering.h"
 
+#include <map>
+#include <set>
+
 namespace llvm {
   class Function;
+  class GlobalVariable;
   class Instruction;
   class Module;
 #if LLVM_VERSION_CODE <= LLVM_VERSION(3, 1)
@@ -177,6 +181,100 @@ private:
                      llvm::BasicBlock *defaultBlock);
 };
 
+/// SharedAccessPass - Finds the instructions that may touch memory shared
+/// between threads, so that the scheduler can ignore all others. It does
+/// not change the module.
+///
+/// The analysis is conservative. A load or store is thread-local only if
+/// every object its pointer may point to is an alloca of the same function
+/// whose address never escapes: it is only loaded from, stored to, compared
+/// and offset, never stored, passed to a call or converted to an integer.
+/// Calls of the pthread functions KLEE models, fences and atomic
+/// instructions are synchronization.
+class SharedAccessPass : public llvm::ModulePass {
+  static char ID;
+  std::set<const llvm::Instruction*> shared;
+  std::set<const llvm::Instruction*> sync;
+  std::map<const llvm::AllocaInst*, bool> escaping;
+
+  bool allocaEscapes(const llvm::AllocaInst *ai);
+  bool isThreadLocalPointer(const llvm::Value *pointer);
+
+public:
+  SharedAccessPass() : llvm::ModulePass(ID) {}
+
+  virtual bool runOnModule(llvm::Module &M);
+  virtual void getAnalysisUsage(llvm::AnalysisUsage &AU) const {
+    AU.setPreservesAll();
+  }
+
+  bool isShared(const llvm::Instruction *i) const {
+    return shared.count(i) != 0;
+  }
+  bool isSync(const llvm::Instruction *i) const {
+    return sync.count(i) != 0;
+  }
+};
+
+/// LocksetPass - A static lockset analysis. It computes the mutexes that
+/// must be held at every load and store and finds the global variables that
+/// are consistently protected: every access of them holds a common mutex,
+/// and their address is only used by loads and stores, so no access can
+/// hide behind a pointer. It does not change the module.
+///
+/// Within a function, a mutex is held after pthread_mutex_lock of it until
+/// pthread_mutex_unlock of it, or of an unknown mutex, or a call that may
+/// release mutexes. Mutexes held by the caller are not known, so accesses in
+/// functions called under a lock are not protected. Only mutexes and
+/// variables with a constant address are tracked.
+///
+/// For the accesses of protected variables it finds
+///  - the loads that must read a store of the same address earlier in their
+///    own critical section, so the write of no other thread can intervene;
+///  - the accesses after which, on every path, the next visible operation of
+///    the thread is another protected access in the same critical section,
+///    so no other thread needs to be scheduled in between.
+class LocksetPass : public llvm::ModulePass {
+  static char ID;
+  typedef std::set<const llvm::Value*> ValueSet;
+  enum Analysis {
+    HeldLocks,
+    WrittenAddresses
+  };
+
+  std::set<const llvm::Function*> releasing;
+  std::map<const llvm::Instruction*, ValueSet> heldLocks;
+  std::map<const llvm::GlobalVariable*, ValueSet> protection;
+  std::set<const llvm::Instruction*> readsOwnWrite;
+  std::set<const llvm::Instruction*> noSwitchAfter;
+
+  void findReleasingFunctions(llvm::Module &M);
+  bool mayRelease(const llvm::Instruction *i);
+  const llvm::GlobalVariable *getProtectedVariable(const llvm::Instruction *i);
+  bool isVisible(const llvm::Instruction *i);
+  void transfer(Analysis analysis, const llvm::Instruction *i, ValueSet &state);
+  void solve(llvm::Function &f, Analysis analysis);
+  void findSwitchPoints(llvm::Function &f);
+
+public:
+  LocksetPass() : llvm::ModulePass(ID) {}
+
+  virtual bool runOnModule(llvm::Module &M);
+  virtual void getAnalysisUsage(llvm::AnalysisUsage &AU) const {
+    AU.setPreservesAll();
+  }
+
+  bool isProtected(const llvm::Instruction *i) {
+    return getProtectedVariable(i) != 0;
+  }
+  bool isReadingOwnWrite(const llvm::Instruction *i) const {
+    return readsOwnWrite.count(i) != 0;
+  }
+  bool isNoSwitchAfter(const llvm::Instruction *i) const {
+    return noSwitchAfter.count(i) != 0;
+  }
+};
+
 }
 
 #endif
@@ -0,0 +1,162 @@
+//===-- SharedAccess.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#include "klee/Config/Version.h"
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#else
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#endif
+#include "llvm/Support/CallSite.h"
+
+#include <vector>
+
+using namespace llvm;
+
+namespace klee {
+
+char SharedAccessPass::ID;
+
+/// The pthread functions handled by SpecialFunctionHandler.
+static const char *syncFunctions[] = {
+  "pthread_create", "pthread_exit", "pthread_cancel", "pthread_join",
+  "pthread_mutex_lock", "pthread_mutex_unlock",
+  "pthread_cond_wait", "pthread_cond_signal", "pthread_cond_broadcast",
+  "pthread_barrier_init", "pthread_barrier_wait", "pthread_barrier_destory"
+};
+
+static bool isSyncFunction(const Function *f) {
+  if (!f)
+    return false;
+  for (unsigned i = 0; i < sizeof(syncFunctions) / sizeof(syncFunctions[0]); ++i)
+    if (f->getName() == syncFunctions[i])
+      return true;
+  return false;
+}
+
+bool SharedAccessPass::allocaEscapes(const AllocaInst *ai) {
+  std::map<const AllocaInst*, bool>::iterator it = escaping.find(ai);
+  if (it != escaping.end())
+    return it->second;
+
+  // Follow the pointers derived from ai until one of them escapes.
+  bool escapes = false;
+  std::set<const Value*> visited;
+  std::vector<const Value*> worklist(1, ai);
+  while (!worklist.empty() && !escapes) {
+    const Value *v = worklist.back();
+    worklist.pop_back();
+    if (!visited.insert(v).second)
+      continue;
+    for (Value::const_use_iterator ui = v->use_begin(), ue = v->use_end();
+         ui != ue; ++ui) {
+      const User *u = *ui;
+      if (isa<LoadInst>(u) || isa<ICmpInst>(u))
+        continue;
+      if (const StoreInst *si = dyn_cast<StoreInst>(u)) {
+        if (si->getValueOperand() == v) {
+          escapes = true;
+          break;
+        }
+        continue;
+      }
+      if (isa<GetElementPtrInst>(u) || isa<BitCastInst>(u) ||
+          isa<PHINode>(u) || isa<SelectInst>(u)) {
+        worklist.push_back(u);
+        continue;
+      }
+      escapes = true;
+      break;
+    }
+  }
+  escaping.insert(std::make_pair(ai, escapes));
+  return escapes;
+}
+
+bool SharedAccessPass::isThreadLocalPointer(const Value *pointer) {
+  std::set<const Value*> visited;
+  std::vector<const Value*> worklist(1, pointer);
+  while (!worklist.empty()) {
+    const Value *v = worklist.back();
+    worklist.pop_back();
+    if (!visited.insert(v).second)
+      continue;
+    if (const AllocaInst *ai = dyn_cast<AllocaInst>(v)) {
+      if (allocaEscapes(ai))
+        return false;
+    } else if (const GetElementPtrInst *gep = dyn_cast<GetElementPtrInst>(v)) {
+      worklist.push_back(gep->getPointerOperand());
+    } else if (const BitCastInst *bc = dyn_cast<BitCastInst>(v)) {
+      worklist.push_back(bc->getOperand(0));
+    } else if (const PHINode *phi = dyn_cast<PHINode>(v)) {
+      for (unsigned i = 0, e = phi->getNumIncomingValues(); i != e; ++i)
+        worklist.push_back(phi->getIncomingValue(i));
+    } else if (const SelectInst *si = dyn_cast<SelectInst>(v)) {
+      worklist.push_back(si->getTrueValue());
+      worklist.push_back(si->getFalseValue());
+    } else {
+      // globals, arguments, loaded pointers, heap objects, ...
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SharedAccessPass::runOnModule(Module &M) {
+  shared.clear();
+  sync.clear();
+  escaping.clear();
+
+  for (Module::iterator f = M.begin(), fe = M.end(); f != fe; ++f) {
+    for (Function::iterator b = f->begin(), be = f->end(); b != be; ++b) {
+      for (BasicBlock::iterator i = b->begin(), ie = b->end(); i != ie; ++i) {
+        switch (i->getOpcode()) {
+        case Instruction::Load:
+          if (!isThreadLocalPointer(cast<LoadInst>(i)->getPointerOperand()))
+            shared.insert(i);
+          break;
+        case Instruction::Store:
+          if (!isThreadLocalPointer(cast<StoreInst>(i)->getPointerOperand()))
+            shared.insert(i);
+          break;
+        case Instruction::Fence:
+        case Instruction::AtomicCmpXchg:
+        case Instruction::AtomicRMW:
+          sync.insert(i);
+          break;
+        case Instruction::Call:
+        case Instruction::Invoke: {
+          CallSite cs(i);
+          const Function *callee =
+            dyn_cast<Function>(cs.getCalledValue()->stripPointerCasts());
+          if (isSyncFunction(callee))
+            sync.insert(i);
+          else if (!callee || callee->isDeclaration())
+            shared.insert(i); // external code may touch anything
+          break;
+        }
+        case Instruction::VAArg:
+          shared.insert(i);
+          break;
+        default:
+          break;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+}
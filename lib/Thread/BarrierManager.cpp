@@ -64,18 +64,33 @@ bool BarrierManager::wait(std::string barrierName, unsigned threadId, bool& isRe
 			isReleased = true;
 			blockedList = barrier->getBlockedList();
 			barrier->reset();
+			for (vector<unsigned>::iterator ti = blockedList.begin(), te = blockedList.end(); ti != te; ti++) {
+				blockedThreadPool.erase(*ti);
+			}
 		} else {
 			isReleased = false;
+			blockedThreadPool[threadId] = barrierName;
 		}
 		return true;
 	}
 }
 
+bool BarrierManager::getBlockingBarrier(unsigned threadId, string& barrierName) {
+	map<unsigned, string>::iterator bi = blockedThreadPool.find(threadId);
+	if (bi == blockedThreadPool.end()) {
+		return false;
+	} else {
+		barrierName = bi->second;
+		return true;
+	}
+}
+
 void BarrierManager::clear() {
 	for (map<string, Barrier*>::iterator bi = barrierPool.begin(), be = barrierPool.end(); bi != be; bi++) {
 		delete bi->second;
 	}
 	barrierPool.clear();
+	blockedThreadPool.clear();
 }
 
 void BarrierManager::print(ostream &out) {
@@ -16,6 +16,7 @@ namespace klee {
 class BarrierManager {
 private:
 	std::map<std::string, Barrier*> barrierPool;
+	std::map<unsigned, std::string> blockedThreadPool; //key--thread, value--the barrier it waits at
 
 public:
 	BarrierManager();
@@ -24,6 +25,7 @@ public:
 	bool wait(std::string barrierName, unsigned threadId, bool& isReleased, std::vector<unsigned>& blockedList, std::string& errorMsg);
 	bool addBarrier(std::string barrierName, std::string& errorMsg);
 	Barrier* getBarrier(std::string barrierName);
+	bool getBlockingBarrier(unsigned threadId, std::string& barrierName);
 	void clear();
 	void print(std::ostream &out);
 };
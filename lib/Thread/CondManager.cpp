@@ -37,6 +37,7 @@ bool CondManager::wait(string condName, string mutexName, unsigned threadId, str
 	} else {
 		WaitParam* wp = new WaitParam(mutexName, threadId);
 		cond->wait(wp);
+		waitingThreadPool[threadId] = condName;
 		return mutexManager->unlock(mutexName, errorMsg);
 	}
 }
@@ -50,6 +51,7 @@ bool CondManager::signal(string condName, unsigned& releasedThreadId, string& er
 		WaitParam* wp = cond->signal();
 		if (wp != NULL) {
 			releasedThreadId = wp->threadId;
+			waitingThreadPool.erase(wp->threadId);
 			//change state
 			mutexManager->addBlockedThread(wp->threadId, wp->mutexName);
 			delete wp;
@@ -73,6 +75,7 @@ bool CondManager::broadcast(string condName, vector<unsigned>& threads, string&
 		for (vector<WaitParam*>::iterator wi = itemList.begin(), we = itemList.end(); wi != we; wi++, ti++) {
 			WaitParam* wp = *wi;
 			*ti = wp->threadId;
+			waitingThreadPool.erase(wp->threadId);
 			mutexManager->addBlockedThread(wp->threadId, wp->mutexName);
 			delete wp;
 		}
@@ -108,6 +111,16 @@ bool CondManager::addCondition(string condName, string& errorMsg, Prefix* prefix
 	}
 }
 
+bool CondManager::getWaitingCondition(unsigned threadId, string& condName) {
+	map<unsigned, string>::iterator wi = waitingThreadPool.find(threadId);
+	if (wi == waitingThreadPool.end()) {
+		return false;
+	} else {
+		condName = wi->second;
+		return true;
+	}
+}
+
 Condition* CondManager::getCondition(string condName) {
 	map<string, Condition*>::iterator ci = condPool.find(condName);
 	if (ci == condPool.end()) {
@@ -135,6 +148,7 @@ void CondManager::clear() {
 		delete ci->second;
 	}
 	condPool.clear();
+	waitingThreadPool.clear();
 	nextConditionId = 1;
 }
 
@@ -25,6 +25,7 @@ namespace klee {
 class CondManager {
 private:
 	std::map<std::string, Condition*> condPool;
+	std::map<unsigned, std::string> waitingThreadPool; //key--thread, value--the condition it waits for
 	MutexManager* mutexManager;
 	unsigned nextConditionId;
 
@@ -38,6 +39,7 @@ public:
 	bool addCondition(std::string condName, std::string& errorMsg);
 	bool addCondition(std::string condName, std::string& errorMsg, Prefix* prefix);
 	Condition* getCondition(std::string condName);
+	bool getWaitingCondition(unsigned threadId, std::string& condName);
 	void setMutexManager(MutexManager* mutexManager) {this->mutexManager = mutexManager;}
 	void clear();
 	void print(std::ostream &out);
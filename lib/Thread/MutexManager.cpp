@@ -135,4 +135,14 @@ bool MutexManager::tryToLockForBlockedThread(unsigned threadId, bool& isBlocked,
 	}
 }
 
+//the mutex a blocked thread waits for, NULL if the thread is not blocked
+Mutex* MutexManager::getBlockingMutex(unsigned threadId) {
+	map<unsigned, Mutex*>::iterator mi = blockedThreadPool.find(threadId);
+	if (mi == blockedThreadPool.end()) {
+		return NULL;
+	} else {
+		return mi->second;
+	}
+}
+
 }
@@ -37,6 +37,7 @@ public:
 	unsigned getNextMutexId();
 	void addBlockedThread(unsigned threadId, std::string mutexName);
 	bool tryToLockForBlockedThread(unsigned threadId, bool& isBlocked, std::string& errorMsg);
+	Mutex* getBlockingMutex(unsigned threadId);
 
 };
 
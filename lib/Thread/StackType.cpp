@@ -71,7 +71,7 @@ namespace klee {
 					out << ", ";
 				out << ai->getName().str();
 				// XXX should go through function
-				ref<Expr> value = sf.locals[sf.kf->getArgRegister(index++)].value;
+				ref<Expr> value = sf.locals[sf.kf->getArgRegister(index++)].getValue();
 				if (isa<ConstantExpr>(value))
 					out << "=" << value;
 			}
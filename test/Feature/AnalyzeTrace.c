@@ -0,0 +1,36 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --analyze-trace %t1.bc 2>&1 | FileCheck %s
+
+/* Each new trace is encoded and verified, then DTAM and PTS run on it.
+ */
+#include <pthread.h>
+
+int x;
+int counter;
+pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER;
+
+void *worker(void *arg) {
+  pthread_mutex_lock(&m);
+  x = x + 1;
+  pthread_mutex_unlock(&m);
+  __sync_fetch_and_add(&counter, 1);
+  return 0;
+}
+
+int main() {
+  pthread_t t;
+
+  pthread_create(&t, 0, worker, 0);
+  pthread_mutex_lock(&m);
+  x = x + 2;
+  pthread_mutex_unlock(&m);
+  __sync_fetch_and_add(&counter, 1);
+  pthread_join(t, 0);
+  return 0;
+}
+
+// CHECK: 本条路径为新路径
+// CHECK: Verifying this trace
+// CHECK: The number of assert: 0
+// CHECK: Sum of branches: 0
@@ -0,0 +1,34 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --analyze-trace %t1.bc 2>&1 | FileCheck %s
+
+/* The branch on x may be flipped by running main's read before the
+ * write of the worker, while the assert holds in every interleaving.
+ */
+#include <assert.h>
+#include <pthread.h>
+
+int x;
+int y;
+
+void *worker(void *arg) {
+  x = 1;
+  return 0;
+}
+
+int main() {
+  pthread_t t;
+
+  pthread_create(&t, 0, worker, 0);
+  if (x == 1)
+    y = 1;
+  pthread_join(t, 0);
+  assert(x != 2);
+  return 0;
+}
+
+// CHECK: Solver strategy: {{(idl|lia|bv|auto|default)}}
+// CHECK: The number of assert: 1
+// CHECK: Verifying 1 asserts @{{.*}}No!
+// CHECK: Sum of branches: 1
+// CHECK: Verifying branch 1 @{{.*}}Yes!
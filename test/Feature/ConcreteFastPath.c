@@ -0,0 +1,86 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t1.bc 2>&1 | FileCheck %s
+
+/* Concrete integer operands of at most 64 bits are computed inline in their
+ * registers. Each operation is done once on concrete operands and once on
+ * symbolic copies of them, which goes through the Expr library, and both
+ * results are printed.
+ */
+#include "klee/klee.h"
+
+#include <limits.h>
+#include <stdio.h>
+
+static int sym32(int value, const char *name) {
+  int s;
+  klee_make_symbolic(&s, sizeof(s), name);
+  klee_assume(s == value);
+  return s;
+}
+
+static long long sym64(long long value, const char *name) {
+  long long s;
+  klee_make_symbolic(&s, sizeof(s), name);
+  klee_assume(s == value);
+  return s;
+}
+
+int main() {
+  volatile int min32 = INT_MIN, minus32 = -1, one32 = 1, neg32 = -8;
+  volatile long long min64 = LLONG_MIN, minus64 = -1;
+  volatile unsigned width32 = 32, over32 = 40, width64 = 64;
+  int smin32 = sym32(min32, "min32"), sminus32 = sym32(minus32, "minus32");
+  int sone32 = sym32(one32, "one32"), sneg32 = sym32(neg32, "neg32");
+  long long smin64 = sym64(min64, "min64"), sminus64 = sym64(minus64, "minus64");
+  unsigned swidth32 = sym32(width32, "width32"), sover32 = sym32(over32, "over32");
+  unsigned swidth64 = sym32(width64, "width64");
+
+  // CHECK: sdiv32 -2147483648 -2147483648
+  printf("sdiv32 %d %d\n", min32 / minus32,
+         klee_get_value_i32(smin32 / sminus32));
+  // CHECK: srem32 0 0
+  printf("srem32 %d %d\n", min32 % minus32,
+         klee_get_value_i32(smin32 % sminus32));
+  // CHECK: sdiv64 -9223372036854775808 -9223372036854775808
+  printf("sdiv64 %lld %lld\n", min64 / minus64,
+         klee_get_value_i64(smin64 / sminus64));
+  // CHECK: srem64 0 0
+  printf("srem64 %lld %lld\n", min64 % minus64,
+         klee_get_value_i64(smin64 % sminus64));
+
+  // shifts by the width or more are left to the Expr library
+  // CHECK: shl32 0 0
+  printf("shl32 %d %d\n", one32 << width32,
+         klee_get_value_i32(sone32 << swidth32));
+  // CHECK: lshr32 0 0
+  printf("lshr32 %u %u\n", (unsigned) minus32 >> over32,
+         (unsigned) klee_get_value_i32((unsigned) sminus32 >> sover32));
+  // CHECK: ashr32 -1 -1
+  printf("ashr32 %d %d\n", neg32 >> over32,
+         klee_get_value_i32(sneg32 >> sover32));
+  // CHECK: shl64 0 0
+  printf("shl64 %lld %lld\n", (long long) one32 << width64,
+         klee_get_value_i64((long long) sone32 << swidth64));
+  // CHECK: ashr31 -1 -1
+  printf("ashr31 %d %d\n", min32 >> (width32 - 1),
+         klee_get_value_i32(smin32 >> (swidth32 - 1)));
+
+  // sext and trunc
+  // CHECK: sext8 -1 -1
+  printf("sext8 %d %d\n", (int) (signed char) minus32,
+         klee_get_value_i32((int) (signed char) sminus32));
+  // CHECK: trunc8 0 0
+  printf("trunc8 %d %d\n", (int) (unsigned char) min32,
+         klee_get_value_i32((int) (unsigned char) smin32));
+  // CHECK: sext16 -8 -8
+  printf("sext16 %lld %lld\n", (long long) (short) neg32,
+         klee_get_value_i64((long long) (short) sneg32));
+  // CHECK: zext32 4294967295 4294967295
+  printf("zext32 %lld %lld\n", (long long) (unsigned) minus32,
+         klee_get_value_i64((long long) (unsigned) sminus32));
+  // CHECK: trunc32 0 0
+  printf("trunc32 %d %d\n", (int) min64,
+         klee_get_value_i32((int) smin64));
+  return 0;
+}
@@ -0,0 +1,85 @@
+; RUN: llvm-as %s -f -o %t1.bc
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out -disable-opt %t1.bc > %t2
+; RUN: grep PASS %t2
+
+; i1 arithmetic, i1 casts and GEPs with negative indices through the concrete
+; fast paths. Expected values are the ones APInt gives on the Expr path.
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare i32 @puts(i8*)
+
+@.passstr = private constant [5 x i8] c"PASS\00", align 1
+@.failstr = private constant [5 x i8] c"FAIL\00", align 1
+@arr = global [4 x i32] [i32 0, i32 1, i32 2, i32 3], align 4
+
+define i32 @main() {
+entry:
+  %tslot = alloca i1
+  %fslot = alloca i1
+  store i1 true, i1* %tslot
+  store i1 false, i1* %fslot
+  %t = load i1* %tslot
+  %f = load i1* %fslot
+
+  ; add i1 1, 1 wraps to 0
+  %add = add i1 %t, %t
+  %ok0 = icmp eq i1 %add, false
+  ; sub i1 0, 1 wraps to 1
+  %sub = sub i1 %f, %t
+  %ok1 = icmp eq i1 %sub, true
+  %mul = mul i1 %t, %t
+  %ok2 = icmp eq i1 %mul, true
+  ; -1 / -1 overflows back to -1
+  %sdiv = sdiv i1 %t, %t
+  %ok3 = icmp eq i1 %sdiv, true
+  %srem = srem i1 %t, %t
+  %ok4 = icmp eq i1 %srem, false
+  %xor = xor i1 %t, %t
+  %ok5 = icmp eq i1 %xor, false
+  %ashr = ashr i1 %t, %f
+  %ok6 = icmp eq i1 %ashr, true
+  %sext = sext i1 %t to i32
+  %ok7 = icmp eq i32 %sext, -1
+  %zext = zext i1 %t to i64
+  %ok8 = icmp eq i64 %zext, 1
+  %trunc = trunc i32 %sext to i1
+  %ok9 = icmp eq i1 %trunc, true
+
+  ; negative indices, including an i32 one that has to be sign extended
+  %base = alloca [4 x i32], align 4
+  %p1 = getelementptr [4 x i32]* %base, i64 0, i64 1
+  %p3 = getelementptr [4 x i32]* %base, i64 0, i64 3
+  %p3m2 = getelementptr i32* %p3, i64 -2
+  %ok10 = icmp eq i32* %p3m2, %p1
+  %p2 = getelementptr [4 x i32]* %base, i64 0, i32 2
+  %p2m1 = getelementptr i32* %p2, i32 -1
+  %ok11 = icmp eq i32* %p2m1, %p1
+  %g = getelementptr i32* getelementptr inbounds ([4 x i32]* @arr, i64 0, i64 3), i32 -2
+  %gv = load i32* %g
+  %ok12 = icmp eq i32 %gv, 1
+
+  %a0 = and i1 %ok0, %ok1
+  %a1 = and i1 %a0, %ok2
+  %a2 = and i1 %a1, %ok3
+  %a3 = and i1 %a2, %ok4
+  %a4 = and i1 %a3, %ok5
+  %a5 = and i1 %a4, %ok6
+  %a6 = and i1 %a5, %ok7
+  %a7 = and i1 %a6, %ok8
+  %a8 = and i1 %a7, %ok9
+  %a9 = and i1 %a8, %ok10
+  %a10 = and i1 %a9, %ok11
+  %a11 = and i1 %a10, %ok12
+  br i1 %a11, label %bbtrue, label %bbfalse
+
+bbtrue:
+  %0 = call i32 @puts(i8* getelementptr inbounds ([5 x i8]* @.passstr, i64 0, i64 0)) nounwind
+  ret i32 0
+
+bbfalse:
+  %1 = call i32 @puts(i8* getelementptr inbounds ([5 x i8]* @.failstr, i64 0, i64 0)) nounwind
+  ret i32 0
+}
@@ -0,0 +1,22 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t1.bc 2>&1 | FileCheck %s
+
+/* The only thread waits for a condition which no thread can signal.
+ */
+#include <pthread.h>
+
+pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t c = PTHREAD_COND_INITIALIZER;
+
+int main() {
+  pthread_mutex_lock(&m);
+  // FIXME: Need newer FileCheck for to do ``[[@LINE+1]]``
+  // Just hardcode line number for now
+  // CHECK: deadlock of 1 threads
+  // CHECK-NEXT: thread 1 at {{.*}}DeadlockCondition.c : 19 waits for condition {{[0-9]+}}
+  // CHECK: 执行有错误
+  pthread_cond_wait(&c, &m);
+  pthread_mutex_unlock(&m);
+  return 0;
+}
@@ -0,0 +1,30 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t1.bc 2>&1 | FileCheck %s
+
+/* A thread returns without unlocking its mutex, so nobody can take it any
+ * more.
+ */
+#include <pthread.h>
+
+pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER;
+
+void *worker(void *arg) {
+  pthread_mutex_lock(&m);
+  return 0;
+}
+
+int main() {
+  pthread_t t;
+
+  pthread_create(&t, 0, worker, 0);
+  pthread_join(t, 0);
+  // FIXME: Need newer FileCheck for to do ``[[@LINE+1]]``
+  // Just hardcode line number for now
+  // CHECK: deadlock of 1 threads
+  // CHECK-NEXT: thread 1 at {{.*}}DeadlockFinishedOwner.c : 27 waits for mutex {{[0-9]+}} held by thread 2 which has finished
+  // CHECK: 执行有错误
+  pthread_mutex_lock(&m);
+  pthread_mutex_unlock(&m);
+  return 0;
+}
@@ -0,0 +1,29 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t1.bc 2>&1 | FileCheck %s
+
+/* The main thread and the thread it creates join each other.
+ */
+#include <pthread.h>
+
+pthread_t mainThread;
+
+void *worker(void *arg) {
+  pthread_join(mainThread, 0);
+  return 0;
+}
+
+int main() {
+  pthread_t t;
+
+  mainThread = pthread_self();
+  pthread_create(&t, 0, worker, 0);
+  // FIXME: Need newer FileCheck for to do ``[[@LINE+1]]``
+  // Just hardcode line number for now
+  // CHECK: deadlock of 2 threads
+  // CHECK-NEXT: thread 1 at {{.*}}DeadlockJoinCycle.c : 27 joins thread 2
+  // CHECK-NEXT: thread 2 at {{.*}}DeadlockJoinCycle.c : 12 joins thread 1
+  // CHECK: 执行有错误
+  pthread_join(t, 0);
+  return 0;
+}
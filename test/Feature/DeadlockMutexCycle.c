@@ -0,0 +1,43 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t1.bc 2>&1 | FileCheck %s
+
+/* Two threads lock two mutexes in opposite orders. The barrier makes sure
+ * each holds its first mutex before either asks for its second one.
+ */
+#include <pthread.h>
+
+pthread_mutex_t a = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t b = PTHREAD_MUTEX_INITIALIZER;
+pthread_barrier_t barrier;
+
+void *worker(void *arg) {
+  pthread_mutex_lock(&b);
+  pthread_barrier_wait(&barrier);
+  pthread_mutex_lock(&a);
+  pthread_mutex_unlock(&a);
+  pthread_mutex_unlock(&b);
+  return 0;
+}
+
+int main() {
+  pthread_t t;
+
+  pthread_barrier_init(&barrier, 0, 2);
+  pthread_mutex_lock(&a);
+  pthread_create(&t, 0, worker, 0);
+  pthread_barrier_wait(&barrier);
+  // FIXME: Need newer FileCheck for to do ``[[@LINE+1]]``
+  // Just hardcode line number for now
+  // CHECK: deadlock of 2 threads
+  // CHECK-NEXT: thread 1 at {{.*}}DeadlockMutexCycle.c : 37 waits for mutex {{[0-9]+}} held by thread 2
+  // CHECK-NEXT: thread 2 at {{.*}}DeadlockMutexCycle.c : 17 waits for mutex {{[0-9]+}} held by thread 1
+  // CHECK-NOT: which has finished
+  // CHECK: 执行有错误
+  pthread_mutex_lock(&b);
+  pthread_mutex_unlock(&b);
+  pthread_mutex_unlock(&a);
+
+  pthread_join(t, 0);
+  return 0;
+}
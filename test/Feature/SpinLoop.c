@@ -0,0 +1,38 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t1.bc 2>&1 | FileCheck %s
+
+/* A loop which only polls a global variable is busy waiting: its thread
+ * yields and the further reads are collapsed. A loop which computes with
+ * the global variable it rereads is not.
+ */
+#include <pthread.h>
+
+int flag;
+int x = 1;
+int sum;
+
+void *setter(void *arg) {
+  flag = 1;
+  return 0;
+}
+
+int main() {
+  pthread_t t;
+  int i, local = 0;
+
+  // CHECK-NOT: busy-wait loop
+  for (i = 0; i < 32; i++)
+    local += x;
+  sum = local;
+
+  pthread_create(&t, 0, setter, 0);
+  // FIXME: Need newer FileCheck for to do ``[[@LINE+1]]``
+  // Just hardcode line number for now
+  // CHECK: busy-wait loop at {{.*}}SpinLoop.c:33
+  while (!flag)
+    ;
+
+  pthread_join(t, 0);
+  return 0;
+}
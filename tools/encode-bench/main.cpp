@@ -0,0 +1,267 @@
+//===-- main.cpp ------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Replays the SMT-LIB2 queries written by klee -encode-dump-queries and
+// reports the latency distribution, so the encoding and the Z3 parameters can
+// be tuned without rerunning the symbolic execution.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <z3.h>
+
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+  cl::list<std::string>
+  InputFiles(cl::desc("<query.smt2 ...>"), cl::Positional, cl::ZeroOrMore);
+
+  cl::opt<std::string>
+  InputList("list",
+            cl::desc("File with one query path per line, for corpora too large for the command line"),
+            cl::init(""));
+
+  enum Strategy {
+    AsDumped,
+    IDL,
+    LIA,
+    BV
+  };
+
+  cl::opt<Strategy>
+  SolverStrategy("strategy",
+                 cl::desc("Logic and tactics used to solve the queries (default=dumped)"),
+                 cl::values(clEnumValN(AsDumped, "dumped", "z3 general purpose solver, as written by klee"),
+                            clEnumValN(IDL, "idl", "QF_IDL"),
+                            clEnumValN(LIA, "lia", "QF_LIA"),
+                            clEnumValN(BV, "bv", "simplify/propagate-values/solve-eqs/smt tactic pipeline"),
+                            clEnumValEnd),
+                 cl::init(AsDumped));
+
+  cl::list<std::string>
+  Z3Params("param",
+           cl::desc("Global z3 parameter name=value, may be repeated (e.g. -param smt.arith.solver=2)"));
+
+  cl::opt<unsigned>
+  Timeout("timeout",
+          cl::desc("Time limit of each query in ms, 0 means unlimited (default=0)"),
+          cl::init(0));
+
+  cl::opt<unsigned>
+  Threads("solver-threads",
+          cl::desc("Number of queries solved in parallel, each in its own context (default=1)"),
+          cl::init(1));
+
+  cl::opt<bool>
+  Verbose("v",
+          cl::desc("Print the result and latency of every query"),
+          cl::init(false));
+
+  struct QueryResult {
+    std::string result;
+    double cost;
+  };
+
+  struct Workload {
+    std::vector<std::string> *files;
+    std::vector<QueryResult> *results;
+    unsigned next;
+    pthread_mutex_t lock;
+  };
+}
+
+static bool readFile(const std::string &path, std::string &content) {
+  std::ifstream in(path.c_str());
+  if (!in)
+    return false;
+  std::stringstream ss;
+  ss << in.rdbuf();
+  content = ss.str();
+  return true;
+}
+
+/// Rewrite the query for the selected strategy. klee dumps the queries
+/// without set-logic and with a plain check-sat.
+static std::string prepareQuery(const std::string &query) {
+  std::stringstream ss;
+  if (Timeout)
+    ss << "(set-option :timeout " << Timeout << ")\n";
+  if (SolverStrategy == IDL)
+    ss << "(set-logic QF_IDL)\n";
+  else if (SolverStrategy == LIA)
+    ss << "(set-logic QF_LIA)\n";
+  if (SolverStrategy != BV) {
+    ss << query;
+    return ss.str();
+  }
+  std::string body = query;
+  std::string::size_type pos = body.rfind("(check-sat)");
+  if (pos != std::string::npos)
+    body.replace(pos, 11, "(check-sat-using (then simplify propagate-values solve-eqs smt))");
+  ss << body;
+  return ss.str();
+}
+
+static void solveQuery(const std::string &path, QueryResult &res) {
+  std::string query;
+  if (!readFile(path, query)) {
+    res.result = "missing";
+    res.cost = 0;
+    return;
+  }
+  query = prepareQuery(query);
+
+  Z3_config cfg = Z3_mk_config();
+  Z3_context ctx = Z3_mk_context(cfg);
+  Z3_del_config(cfg);
+  // errors are reported through the output of the script
+  Z3_set_error_handler(ctx, NULL);
+
+  struct timeval start, finish;
+  gettimeofday(&start, NULL);
+  Z3_string out = Z3_eval_smtlib2_string(ctx, query.c_str());
+  gettimeofday(&finish, NULL);
+  res.cost = (double) (finish.tv_sec * 1000000UL + finish.tv_usec -
+                       start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
+
+  std::string output = out ? out : "";
+  if (output.find("unsat") != std::string::npos)
+    res.result = "unsat";
+  else if (output.find("sat") != std::string::npos &&
+           output.find("unknown") == std::string::npos)
+    res.result = "sat";
+  else if (output.find("error") != std::string::npos)
+    res.result = "error";
+  else
+    res.result = "unknown";
+  Z3_del_context(ctx);
+}
+
+static void *worker(void *arg) {
+  Workload *work = (Workload *) arg;
+  for (;;) {
+    pthread_mutex_lock(&work->lock);
+    unsigned i = work->next++;
+    pthread_mutex_unlock(&work->lock);
+    if (i >= work->files->size())
+      break;
+    solveQuery((*work->files)[i], (*work->results)[i]);
+  }
+  return NULL;
+}
+
+static double percentile(const std::vector<double> &sorted, double p) {
+  if (sorted.empty())
+    return 0;
+  unsigned idx = (unsigned) (p * (sorted.size() - 1) + 0.5);
+  return sorted[idx];
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "Encode query benchmark\n");
+
+  std::vector<std::string> files(InputFiles.begin(), InputFiles.end());
+  if (!InputList.empty()) {
+    std::ifstream in(InputList.c_str());
+    if (!in) {
+      errs() << argv[0] << ": error: can not read " << InputList << "\n";
+      return 1;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+      if (!line.empty())
+        files.push_back(line);
+    }
+  }
+  if (files.empty()) {
+    errs() << argv[0] << ": error: no queries given\n";
+    return 1;
+  }
+
+  // global parameters have to be set before any context is created
+  for (unsigned i = 0; i < Z3Params.size(); i++) {
+    std::string::size_type eq = Z3Params[i].find('=');
+    if (eq == std::string::npos) {
+      errs() << argv[0] << ": error: -param expects name=value, got " << Z3Params[i] << "\n";
+      return 1;
+    }
+    Z3_global_param_set(Z3Params[i].substr(0, eq).c_str(),
+                        Z3Params[i].substr(eq + 1).c_str());
+  }
+
+  std::vector<QueryResult> results(files.size());
+  Workload work;
+  work.files = &files;
+  work.results = &results;
+  work.next = 0;
+  pthread_mutex_init(&work.lock, NULL);
+
+  unsigned threadNum = Threads ? Threads : 1;
+  struct timeval start, finish;
+  gettimeofday(&start, NULL);
+  std::vector<pthread_t> threads(threadNum);
+  for (unsigned i = 0; i < threadNum; i++)
+    pthread_create(&threads[i], NULL, worker, &work);
+  for (unsigned i = 0; i < threadNum; i++)
+    pthread_join(threads[i], NULL);
+  gettimeofday(&finish, NULL);
+  pthread_mutex_destroy(&work.lock);
+  double wall = (double) (finish.tv_sec * 1000000UL + finish.tv_usec -
+                          start.tv_sec * 1000000UL - start.tv_usec) / 1000000UL;
+
+  unsigned sat = 0, unsat = 0, unknown = 0, failed = 0;
+  double total = 0;
+  std::vector<double> costs;
+  costs.reserve(results.size());
+  for (unsigned i = 0; i < results.size(); i++) {
+    const QueryResult &res = results[i];
+    if (Verbose)
+      outs() << files[i] << " " << res.result << " " << res.cost << "\n";
+    if (res.result == "sat")
+      sat++;
+    else if (res.result == "unsat")
+      unsat++;
+    else if (res.result == "unknown")
+      unknown++;
+    else
+      failed++;
+    total += res.cost;
+    costs.push_back(res.cost);
+  }
+  std::sort(costs.begin(), costs.end());
+
+  outs() << "Queries: " << results.size() << "\n";
+  outs() << "Sat: " << sat << "\n";
+  outs() << "Unsat: " << unsat << "\n";
+  outs() << "Unknown: " << unknown << "\n";
+  outs() << "Failed: " << failed << "\n";
+  outs() << "Threads: " << threadNum << "\n";
+  outs() << "WallTime: " << wall << "\n";
+  outs() << "SolverTime: " << total << "\n";
+  outs() << "Mean: " << total / results.size() << "\n";
+  outs() << "P50: " << percentile(costs, 0.50) << "\n";
+  outs() << "P90: " << percentile(costs, 0.90) << "\n";
+  outs() << "P99: " << percentile(costs, 0.99) << "\n";
+  outs() << "Max: " << costs.back() << "\n";
+
+  llvm::llvm_shutdown();
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,70 @@
+//===-- VarNameTest.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "Trace.h"
+#include "Memory.h"
+#include "MemoryManager.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Type.h"
+
+#include <string>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+
+/// The names of one execution: a global, then the first allocation of a
+/// site by thread 1 and by thread 2.
+struct Names {
+  std::string global, first, second;
+};
+
+/// Runs one execution with its own MemoryManager, as runFunctionAsMain does.
+/// If swapped, thread 2 allocates before thread 1 and an extra object comes
+/// first, so that the ids of the objects differ from the other execution.
+Names execute(const Value *globalSite, const Value *heapSite, bool swapped) {
+  MemoryManager *memory = new MemoryManager(NULL);
+  Names names;
+  if (swapped)
+    memory->allocate(4, true, false, heapSite, 3);
+  MemoryObject *global = memory->allocate(4, false, true, globalSite);
+  names.global = Trace::createVarName(global, global->address, true);
+  MemoryObject *first = 0, *second = 0;
+  if (swapped) {
+    second = memory->allocate(8, false, false, heapSite, 2);
+    first = memory->allocate(8, false, false, heapSite, 1);
+  } else {
+    first = memory->allocate(8, false, false, heapSite, 1);
+    second = memory->allocate(8, false, false, heapSite, 2);
+  }
+  names.first = Trace::createVarName(first, first->address + 4, false);
+  names.second = Trace::createVarName(second, second->address + 4, false);
+  delete memory;
+  return names;
+}
+
+TEST(VarNameTest, SameNamesInEveryExecution) {
+  LLVMContext ctx;
+  const Value *globalSite = UndefValue::get(Type::getInt32Ty(ctx));
+  const Value *heapSite = UndefValue::get(Type::getInt64Ty(ctx));
+
+  Names one = execute(globalSite, heapSite, false);
+  Names two = execute(globalSite, heapSite, true);
+  EXPECT_EQ(one.global, two.global);
+  EXPECT_EQ(one.first, two.first);
+  EXPECT_EQ(one.second, two.second);
+  EXPECT_NE(one.first, one.second);
+}
+
+}
@@ -0,0 +1,92 @@
+//===-- Z3ToKQueryTest.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "Z3ToKQuery.h"
+
+#include "klee/CommandLine.h"
+#include "klee/Constraints.h"
+#include "klee/Solver.h"
+
+#include <z3++.h>
+
+using namespace klee;
+
+namespace {
+
+/// Lowers f, solves it with the solver chain of KLEE and checks that the z3
+/// model built from the solution satisfies f.
+void checkModel(z3::context &ctx, z3::expr f, unsigned numObjects) {
+  Z3ToKQuery toKQuery(ctx);
+  ref<Expr> e;
+  ASSERT_TRUE(toKQuery.getKQuery(f, e));
+  EXPECT_EQ(numObjects, toKQuery.getObjects().size());
+
+  Solver *solver = createCoreSolver(CoreSolverToUse);
+  solver = createCachingSolver(solver);
+  solver = createIndependentSolver(solver);
+
+  ConstraintManager constraints;
+  constraints.addConstraint(e);
+  std::vector<std::vector<unsigned char> > values;
+  ASSERT_TRUE(solver->getInitialValues(
+      Query(constraints, ConstantExpr::alloc(0, Expr::Bool)),
+      toKQuery.getObjects(), values));
+
+  z3::model model = toKQuery.getModel(values);
+  z3::expr value = model.eval(f, true);
+  EXPECT_EQ(Z3_L_TRUE, Z3_get_bool_value(ctx, value)) << f;
+
+  delete solver;
+}
+
+TEST(Z3ToKQueryTest, OrderVariables) {
+  z3::context ctx;
+  z3::expr a = ctx.int_const("E_a");
+  z3::expr b = ctx.int_const("E_b");
+  z3::expr c = ctx.int_const("E_c");
+  // integers are signed, so a must be negative
+  checkModel(ctx, a < b && b < c && c < 0 && a + 5 > b, 3);
+  checkModel(ctx, a != b && b != c && a != c && (a == 2 || a == -2) &&
+                  z3::ite(a > 0, b, c) == 1, 3);
+}
+
+TEST(Z3ToKQueryTest, Data) {
+  z3::context ctx;
+  z3::expr x = ctx.bv_const("x", 32);
+  z3::expr y = ctx.bv_const("y", 8);
+  z3::expr p = ctx.bool_const("p");
+  z3::expr wide = z3::to_expr(ctx, Z3_mk_zero_ext(ctx, 24, y));
+  z3::expr small = z3::to_expr(ctx, Z3_mk_bvult(ctx, y, ctx.bv_val(10, 8)));
+  checkModel(ctx, x + wide == 300 && small && implies(p, x == 299) &&
+                  (p || x >= 295), 3);
+  z3::expr shifted = z3::to_expr(ctx, Z3_mk_bvlshr(ctx, x, ctx.bv_val(4, 32)));
+  checkModel(ctx, z3::ite(p, x, -x) == -7 && (x & 1) == 1 && shifted != 0 &&
+                  x / 2 < 0, 2);
+  z3::expr byte = z3::to_expr(ctx, Z3_mk_extract(ctx, 15, 8, x));
+  z3::expr twice = z3::to_expr(ctx, Z3_mk_concat(ctx, y, y));
+  checkModel(ctx, byte == y && twice == 0x4141, 2);
+}
+
+TEST(Z3ToKQueryTest, Unsupported) {
+  z3::context ctx;
+  z3::expr r = ctx.real_const("r");
+  z3::sort integer = ctx.int_sort();
+  z3::func_decl f = ctx.function("f", integer, integer);
+  z3::expr a = ctx.int_const("a");
+  ref<Expr> e;
+
+  Z3ToKQuery toKQuery(ctx);
+  EXPECT_FALSE(toKQuery.getKQuery(r > 1, e));
+  EXPECT_FALSE(toKQuery.getKQuery(f(a) == 1, e));
+  EXPECT_TRUE(toKQuery.getKQuery(a < 1, e));
+}
+
+}
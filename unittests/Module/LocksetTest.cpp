@@ -0,0 +1,145 @@
+//===-- LocksetTest.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "Passes.h"
+
+#include "klee/Config/Version.h"
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/ValueSymbolTable.h"
+#else
+#include "llvm/LLVMContext.h"
+#include "llvm/ValueSymbolTable.h"
+#endif
+#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
+#include "llvm/Assembly/Parser.h"
+#else
+#include "llvm/AsmParser/Parser.h"
+#endif
+#include "llvm/Support/SourceMgr.h"
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+
+// x and y are always accessed holding m, z is not
+const char *g_module =
+  "@x = global i32 0\n"
+  "@y = global i32 0\n"
+  "@z = global i32 0\n"
+  "@m = global [40 x i8] zeroinitializer\n"
+  "declare i32 @pthread_mutex_lock(i8*)\n"
+  "declare i32 @pthread_mutex_unlock(i8*)\n"
+  "define void @writer() {\n"
+  "entry:\n"
+  "  %lock = call i32 @pthread_mutex_lock(i8* getelementptr ([40 x i8]* @m, i32 0, i32 0))\n"
+  "  store i32 1, i32* @x\n"
+  "  %readX = load i32* @x\n"
+  "  store i32 %readX, i32* @y\n"
+  "  store i32 2, i32* @z\n"
+  "  %unlock = call i32 @pthread_mutex_unlock(i8* getelementptr ([40 x i8]* @m, i32 0, i32 0))\n"
+  "  ret void\n"
+  "}\n"
+  "define void @reader() {\n"
+  "entry:\n"
+  "  %lock = call i32 @pthread_mutex_lock(i8* getelementptr ([40 x i8]* @m, i32 0, i32 0))\n"
+  "  %readY = load i32* @y\n"
+  "  %unlock = call i32 @pthread_mutex_unlock(i8* getelementptr ([40 x i8]* @m, i32 0, i32 0))\n"
+  "  %readZ = load i32* @z\n"
+  "  ret void\n"
+  "}\n"
+  "define void @branch(i1 %c) {\n"
+  "entry:\n"
+  "  %lock = call i32 @pthread_mutex_lock(i8* getelementptr ([40 x i8]* @m, i32 0, i32 0))\n"
+  "  br i1 %c, label %then, label %join\n"
+  "then:\n"
+  "  store i32 3, i32* @x\n"
+  "  br label %join\n"
+  "join:\n"
+  "  %readJoin = load i32* @x\n"
+  "  %unlock = call i32 @pthread_mutex_unlock(i8* getelementptr ([40 x i8]* @m, i32 0, i32 0))\n"
+  "  ret void\n"
+  "}\n";
+
+Module *parse(LLVMContext &context, const char *text) {
+  SMDiagnostic error;
+  Module *module = ParseAssemblyString(text, 0, error, context);
+  EXPECT_TRUE(module != 0) << error.getMessage().str();
+  return module;
+}
+
+Instruction *getNamed(Module *module, const char *function, const char *name) {
+  Function *f = module->getFunction(function);
+  Instruction *i = dyn_cast_or_null<Instruction>(f->getValueSymbolTable().lookup(name));
+  EXPECT_TRUE(i != 0) << function << ": " << name;
+  return i;
+}
+
+TEST(LocksetTest, ProtectedVariables) {
+  LLVMContext context;
+  Module *module = parse(context, g_module);
+  ASSERT_TRUE(module != 0);
+  LocksetPass pass;
+  pass.runOnModule(*module);
+
+  EXPECT_TRUE(pass.isProtected(getNamed(module, "writer", "readX")));
+  EXPECT_TRUE(pass.isProtected(getNamed(module, "reader", "readY")));
+  EXPECT_TRUE(pass.isProtected(getNamed(module, "branch", "readJoin")));
+  EXPECT_FALSE(pass.isProtected(getNamed(module, "reader", "readZ")));
+
+  delete module;
+}
+
+TEST(LocksetTest, ReadsOwnWrite) {
+  LLVMContext context;
+  Module *module = parse(context, g_module);
+  ASSERT_TRUE(module != 0);
+  LocksetPass pass;
+  pass.runOnModule(*module);
+
+  EXPECT_TRUE(pass.isReadingOwnWrite(getNamed(module, "writer", "readX")));
+  EXPECT_FALSE(pass.isReadingOwnWrite(getNamed(module, "reader", "readY")));
+  // the store is only on one of the paths
+  EXPECT_FALSE(pass.isReadingOwnWrite(getNamed(module, "branch", "readJoin")));
+  EXPECT_FALSE(pass.isReadingOwnWrite(getNamed(module, "reader", "readZ")));
+
+  delete module;
+}
+
+TEST(LocksetTest, NoSwitchAfter) {
+  LLVMContext context;
+  Module *module = parse(context, g_module);
+  ASSERT_TRUE(module != 0);
+  LocksetPass pass;
+  pass.runOnModule(*module);
+
+  Instruction *readX = getNamed(module, "writer", "readX");
+  Instruction *storeX = readX->getPrevNode();
+  ASSERT_TRUE(isa<StoreInst>(storeX));
+  EXPECT_TRUE(pass.isNoSwitchAfter(storeX));
+  EXPECT_TRUE(pass.isNoSwitchAfter(readX));
+  // z is not protected
+  Instruction *storeY = readX->getNextNode();
+  ASSERT_TRUE(isa<StoreInst>(storeY));
+  EXPECT_FALSE(pass.isNoSwitchAfter(storeY));
+  // the next access is across a branch
+  Function *branch = module->getFunction("branch");
+  for (Function::iterator b = branch->begin(), be = branch->end(); b != be; ++b)
+    if (b->getName() == "then")
+      EXPECT_TRUE(pass.isNoSwitchAfter(b->begin()));
+  // the unlock follows
+  EXPECT_FALSE(pass.isNoSwitchAfter(getNamed(module, "branch", "readJoin")));
+
+  delete module;
+}
+
+}
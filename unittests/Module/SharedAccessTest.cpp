@@ -0,0 +1,117 @@
+//===-- SharedAccessTest.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "Passes.h"
+
+#include "klee/Config/Version.h"
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/ValueSymbolTable.h"
+#else
+#include "llvm/LLVMContext.h"
+#include "llvm/ValueSymbolTable.h"
+#endif
+#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
+#include "llvm/Assembly/Parser.h"
+#else
+#include "llvm/AsmParser/Parser.h"
+#endif
+#include "llvm/Support/SourceMgr.h"
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+
+const char *g_module =
+  "@g = global i32 0\n"
+  "@m = global [40 x i8] zeroinitializer\n"
+  "declare i32 @pthread_mutex_lock(i8*)\n"
+  "declare void @external(i32*)\n"
+  "define void @f(i32* %arg) {\n"
+  "entry:\n"
+  "  %local = alloca i32\n"
+  "  %escaped = alloca i32\n"
+  "  %passed = alloca i32\n"
+  "  %field = getelementptr i32* %local, i32 0\n"
+  "  store i32 1, i32* %field\n"
+  "  %loadLocal = load i32* %local\n"
+  "  %int = ptrtoint i32* %escaped to i64\n"
+  "  %loadEscaped = load i32* %escaped\n"
+  "  call void @external(i32* %passed)\n"
+  "  %loadPassed = load i32* %passed\n"
+  "  %loadArg = load i32* %arg\n"
+  "  %loadGlobal = load i32* @g\n"
+  "  %lock = call i32 @pthread_mutex_lock(i8* getelementptr ([40 x i8]* @m, i32 0, i32 0))\n"
+  "  %rmw = atomicrmw add i32* @g, i32 1 seq_cst\n"
+  "  fence seq_cst\n"
+  "  ret void\n"
+  "}\n";
+
+Module *parse(LLVMContext &context, const char *text) {
+  SMDiagnostic error;
+  Module *module = ParseAssemblyString(text, 0, error, context);
+  EXPECT_TRUE(module != 0) << error.getMessage().str();
+  return module;
+}
+
+Instruction *getNamed(Function *f, const char *name) {
+  Instruction *i = dyn_cast_or_null<Instruction>(f->getValueSymbolTable().lookup(name));
+  EXPECT_TRUE(i != 0) << name;
+  return i;
+}
+
+TEST(SharedAccessTest, ThreadLocalAccesses) {
+  LLVMContext context;
+  Module *module = parse(context, g_module);
+  ASSERT_TRUE(module != 0);
+  Function *f = module->getFunction("f");
+  SharedAccessPass pass;
+  pass.runOnModule(*module);
+
+  // a private alloca is not shared, also through a GEP
+  Instruction *store = getNamed(f, "field")->getNextNode();
+  ASSERT_TRUE(isa<StoreInst>(store));
+  EXPECT_FALSE(pass.isShared(store));
+  EXPECT_FALSE(pass.isShared(getNamed(f, "loadLocal")));
+  // an alloca whose address escapes is
+  EXPECT_TRUE(pass.isShared(getNamed(f, "loadEscaped")));
+  EXPECT_TRUE(pass.isShared(getNamed(f, "loadPassed")));
+  EXPECT_TRUE(pass.isShared(getNamed(f, "loadArg")));
+  EXPECT_TRUE(pass.isShared(getNamed(f, "loadGlobal")));
+
+  delete module;
+}
+
+TEST(SharedAccessTest, Synchronization) {
+  LLVMContext context;
+  Module *module = parse(context, g_module);
+  ASSERT_TRUE(module != 0);
+  Function *f = module->getFunction("f");
+  SharedAccessPass pass;
+  pass.runOnModule(*module);
+
+  Instruction *lock = getNamed(f, "lock");
+  EXPECT_TRUE(pass.isSync(lock));
+  EXPECT_FALSE(pass.isShared(lock));
+  Instruction *rmw = getNamed(f, "rmw");
+  EXPECT_TRUE(pass.isSync(rmw));
+  EXPECT_TRUE(pass.isSync(rmw->getNextNode()));
+  // a call of external code is shared, not synchronization
+  Instruction *call = getNamed(f, "loadEscaped")->getNextNode();
+  ASSERT_TRUE(isa<CallInst>(call));
+  EXPECT_TRUE(pass.isShared(call));
+  EXPECT_FALSE(pass.isSync(call));
+
+  delete module;
+}
+
+}